@@ -0,0 +1,192 @@
+/*
+  ==============================================================================
+
+    SemaforteBench
+    Headless micro-benchmark for PluginProcessor::processBlock.
+
+    Usage: SemaforteBench [--csv=results.csv] [--samples=N]
+
+  ==============================================================================
+*/
+
+#include "PluginProcessor.h"
+#include <juce_core/juce_core.h>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+//==============================================================================
+// Count every heap allocation so processBlock can be checked for zero.
+namespace
+{
+    std::atomic<juce::int64> allocationCount { 0 };
+
+    void* countedAlloc(std::size_t size)
+    {
+        allocationCount.fetch_add(1, std::memory_order_relaxed);
+        if (auto* ptr = std::malloc(size == 0 ? 1 : size))
+            return ptr;
+        throw std::bad_alloc();
+    }
+
+    void* countedAlignedAlloc(std::size_t size, std::align_val_t alignment)
+    {
+        allocationCount.fetch_add(1, std::memory_order_relaxed);
+        const auto align = static_cast<std::size_t>(alignment);
+        if (auto* ptr = std::aligned_alloc(align, (juce::jmax(size, std::size_t { 1 }) + align - 1) / align * align))
+            return ptr;
+        throw std::bad_alloc();
+    }
+}
+
+void* operator new(std::size_t size) { return countedAlloc(size); }
+void* operator new[](std::size_t size) { return countedAlloc(size); }
+void* operator new(std::size_t size, std::align_val_t align) { return countedAlignedAlloc(size, align); }
+void* operator new[](std::size_t size, std::align_val_t align) { return countedAlignedAlloc(size, align); }
+void operator delete(void* ptr) noexcept { std::free(ptr); }
+void operator delete[](void* ptr) noexcept { std::free(ptr); }
+void operator delete(void* ptr, std::size_t) noexcept { std::free(ptr); }
+void operator delete[](void* ptr, std::size_t) noexcept { std::free(ptr); }
+void operator delete(void* ptr, std::align_val_t) noexcept { std::free(ptr); }
+void operator delete[](void* ptr, std::align_val_t) noexcept { std::free(ptr); }
+void operator delete(void* ptr, std::size_t, std::align_val_t) noexcept { std::free(ptr); }
+void operator delete[](void* ptr, std::size_t, std::align_val_t) noexcept { std::free(ptr); }
+
+//==============================================================================
+namespace
+{
+    constexpr double kSampleRate = 48000.0;
+
+    enum class FaderState { unity, muted, fading };
+
+    const char* getFaderStateName(FaderState state)
+    {
+        switch (state)
+        {
+            case FaderState::unity:  return "unity";
+            case FaderState::muted:  return "muted";
+            case FaderState::fading: return "fading";
+        }
+        return "";
+    }
+
+    struct Case
+    {
+        int blockSize = 0;
+        int numChannels = 0;
+        FaderState fader = FaderState::unity;
+        int eventsPerBlock = 0;
+    };
+
+    struct Result
+    {
+        double nsPerSample = 0.0;
+        double allocationsPerCall = 0.0;
+    };
+
+    Result runCase(const Case& c, juce::int64 samplesPerCase)
+    {
+        PluginProcessor processor;
+        processor.setMuted(0, c.fader == FaderState::muted);
+        processor.setPlayConfigDetails(c.numChannels, c.numChannels, kSampleRate, c.blockSize);
+        processor.prepareToPlay(kSampleRate, c.blockSize);
+
+        juce::Random random(1);
+        juce::AudioBuffer<float> buffer(c.numChannels, c.blockSize);
+        for (int ch = 0; ch < c.numChannels; ++ch)
+            for (int s = 0; s < c.blockSize; ++s)
+                buffer.setSample(ch, s, random.nextFloat() * 2.0f - 1.0f);
+
+        // Unlearnt notes spread over the block: they go through the debouncer
+        // and trigger lookup without changing the fader state under test.
+        // processBlock doesn't modify the MIDI, so one buffer serves every call.
+        juce::MidiBuffer midi;
+        for (int i = 0; i < c.eventsPerBlock; ++i)
+            midi.addEvent(juce::MidiMessage::noteOn(1, 60, static_cast<juce::uint8>(100)),
+                          i * c.blockSize / c.eventsPerBlock);
+
+        const auto numCalls = juce::jmax(juce::int64 { 16 }, samplesPerCase / c.blockSize);
+        bool muted = c.fader == FaderState::muted;
+
+        // Reversing the fader every call keeps every block inside a ramp. It
+        // is reversed through the mute parameter's value, which is what host
+        // automation writes: a plain store, so the timed loop holds no
+        // message-thread work such as notifying the host.
+        auto* muteValue = processor.parameters.getRawParameterValue("mute1");
+
+        auto runBlock = [&] {
+            if (c.fader == FaderState::fading)
+                muteValue->store((muted = ! muted) ? 1.0f : 0.0f, std::memory_order_relaxed);
+            processor.processBlock(buffer, midi);
+        };
+
+        for (int i = 0; i < 16; ++i)
+            runBlock();
+
+        const auto allocationsBefore = allocationCount.load();
+        const auto start = juce::Time::getHighResolutionTicks();
+
+        for (juce::int64 i = 0; i < numCalls; ++i)
+            runBlock();
+
+        const auto elapsed = juce::Time::highResolutionTicksToSeconds(juce::Time::getHighResolutionTicks() - start);
+        const auto allocations = allocationCount.load() - allocationsBefore;
+
+        return { elapsed * 1.0e9 / static_cast<double>(numCalls * c.blockSize),
+                 static_cast<double>(allocations) / static_cast<double>(numCalls) };
+    }
+}
+
+//==============================================================================
+int main(int argc, char* argv[])
+{
+    // The processor is a Timer, so a message manager has to exist
+    juce::ScopedJuceInitialiser_GUI juceInitialiser;
+
+    juce::ArgumentList args(argc, argv);
+    const auto samplesPerCase = args.containsOption("--samples")
+                              ? static_cast<juce::int64>(args.getValueForOption("--samples").getLargeIntValue())
+                              : juce::int64 { 1 << 20 };
+
+    const int blockSizes[] = { 1, 16, 32, 64, 128, 256, 512, 1024, 2048, 4096 };
+    const int channelCounts[] = { 1, 2, 6, 12, 16, 64 };
+    const FaderState faderStates[] = { FaderState::unity, FaderState::muted, FaderState::fading };
+    const int eventDensities[] = { 0, 1, 8 };
+
+    juce::StringArray csv;
+    csv.add("block_size,channels,fader,events_per_block,ns_per_sample,allocations_per_call");
+
+    std::printf("%6s %4s %7s %6s %12s %12s\n", "block", "ch", "fader", "events", "ns/sample", "allocs/call");
+
+    for (auto blockSize : blockSizes)
+        for (auto numChannels : channelCounts)
+            for (auto fader : faderStates)
+                for (auto events : eventDensities)
+                {
+                    if (events > blockSize)
+                        continue;
+
+                    const Case c { blockSize, numChannels, fader, events };
+                    const auto result = runCase(c, samplesPerCase);
+
+                    std::printf("%6d %4d %7s %6d %12.3f %12.3f\n", blockSize, numChannels,
+                                getFaderStateName(fader), events, result.nsPerSample, result.allocationsPerCall);
+
+                    csv.add(juce::String(blockSize) + "," + juce::String(numChannels) + ","
+                            + getFaderStateName(fader) + "," + juce::String(events) + ","
+                            + juce::String(result.nsPerSample, 3) + "," + juce::String(result.allocationsPerCall, 3));
+                }
+
+    if (args.containsOption("--csv"))
+    {
+        const auto file = args.getFileForOption("--csv");
+        if (! file.replaceWithText(csv.joinIntoString("\n") + "\n"))
+        {
+            std::fprintf(stderr, "Could not write %s\n", file.getFullPathName().toRawUTF8());
+            return 1;
+        }
+    }
+
+    return 0;
+}
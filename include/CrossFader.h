@@ -1,15 +1,77 @@
 #pragma once
 
+#include "FadeCurves.h"
 #include "juce_audio_basics/juce_audio_basics.h"
+#include <type_traits>
+#include <vector>
 
+/**
+ * CrossFader
+ * Gain fader applied a block at a time. The fade moves linearly between
+ * 0 (muted) and 1 (unity) and the selected shape maps that position to a
+ * gain through a precomputed table. While ramping, the gain curve for the
+ * block is generated once and multiplied into every channel; once settled
+ * the block is either left untouched (unity), cleared (muted) or scaled by
+ * a constant.
+ */
 class CrossFader
 {
 public:
-    void prepare(double sampleRate, int fadeTimeMs, float initialGain = 1.0f);
+    enum class Shape { linear, equalPower, exponential, sCurve };
+
+    void prepare(double sampleRate, int fadeTimeMs, int maxBlockSize, float initialGain = 1.0f);
+
+    /** Length of fades started from now on; a fade in progress keeps its length */
+    void setFadeTime(int fadeTimeMs);
+    void setShape(Shape shape);
     void mute();
     void unmute();
-    float getNextGain();
+
+    /** Moves the fade on by numSamples without processing any audio */
+    void advance(int numSamples);
+
+    /** Applies the fader to numSamples samples of every channel, starting at
+        startSample. Instantiated for float and double. */
+    template <typename SampleType>
+    void process(SampleType* const* channels, int numChannels, int startSample, int numSamples);
+
+    bool isSmoothing() const { return countdown_ > 0; }
+    int getFadeSamples() const { return fadeSamples_; }
+    int getSamplesToTarget() const { return countdown_; }
+    float getCurrentGain() const { return shapeGain(current_); }
+    float getTargetGain() const { return target_; }
 
 private:
-    juce::SmoothedValue<float, juce::ValueSmoothingTypes::Linear> fader_;
+    void setTarget(float target);
+    float shapeGain(float position) const;
+
+    // Gain kernels, specialised for mono and stereo (NumChannels 1 and 2)
+    // and generic over numChannels otherwise (NumChannels 0)
+    template <typename SampleType, int NumChannels>
+    void processChannels(SampleType* const* channels, int numChannels, int startSample, int numSamples);
+
+    template <typename SampleType>
+    std::vector<SampleType>& getRamp()
+    {
+        if constexpr (std::is_same_v<SampleType, float>)
+            return floatRamp_;
+        else
+            return doubleRamp_;
+    }
+
+    // Fade positions, 0 = muted, 1 = unity
+    float current_ = 1.0f;
+    float target_ = 1.0f;
+    float rampStart_ = 1.0f;
+    float step_ = 0.0f;
+    int countdown_ = 0;     // samples left until target_ is reached
+    int rampLength_ = 0;    // length of the fade in progress
+    int fadeSamples_ = 0;   // length of the next fade
+    double sampleRate_ = 44100.0;
+
+    const FadeCurves::Table* curve_ = nullptr;  // nullptr for linear
+
+    // Per-block gain curves, one per sample type, sized in prepare()
+    std::vector<float> floatRamp_;
+    std::vector<double> doubleRamp_;
 };
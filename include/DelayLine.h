@@ -0,0 +1,72 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <vector>
+
+/**
+ * DelayLine
+ * Fixed multichannel delay applied in place, used for lookahead. Storage is
+ * allocated in prepare() only; process() swaps each block through the ring
+ * and never allocates.
+ */
+template <typename SampleType>
+class DelayLine
+{
+public:
+    /** Allocates numChannels rings of delaySamples each and clears them */
+    void prepare(int numChannels, int delaySamples)
+    {
+        numChannels_ = std::max(0, numChannels);
+        delaySamples_ = std::max(0, delaySamples);
+        ring_.assign(static_cast<size_t>(numChannels_) * static_cast<size_t>(delaySamples_), SampleType(0));
+        writePos_ = 0;
+    }
+
+    /** Frees the storage; process() is a no-op until prepared again */
+    void release()
+    {
+        numChannels_ = delaySamples_ = writePos_ = 0;
+        ring_.clear();
+        ring_.shrink_to_fit();
+    }
+
+    /** Silences the delayed samples without reallocating */
+    void reset()
+    {
+        std::fill(ring_.begin(), ring_.end(), SampleType(0));
+        writePos_ = 0;
+    }
+
+    int getDelaySamples() const { return delaySamples_; }
+
+    /** Delays numSamples samples of every channel by getDelaySamples() */
+    void process(SampleType* const* channels, int numChannels, int numSamples)
+    {
+        if (delaySamples_ == 0)
+            return;
+
+        numChannels = std::min(numChannels, numChannels_);
+
+        // Each sample takes the ring slot of the one written delaySamples_ ago
+        for (int done = 0; done < numSamples;)
+        {
+            const int n = std::min(numSamples - done, delaySamples_ - writePos_);
+
+            for (int ch = 0; ch < numChannels; ++ch)
+            {
+                auto* ring = ring_.data() + static_cast<size_t>(ch) * static_cast<size_t>(delaySamples_) + writePos_;
+                std::swap_ranges(channels[ch] + done, channels[ch] + done + n, ring);
+            }
+
+            done += n;
+            writePos_ = (writePos_ + n) % delaySamples_;
+        }
+    }
+
+private:
+    int numChannels_ = 0;
+    int delaySamples_ = 0;
+    int writePos_ = 0;
+    std::vector<SampleType> ring_;
+};
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <juce_gui_basics/juce_gui_basics.h>
+#include "PluginProcessor.h"
+
+/**
+ * DiagnosticsView
+ * Shows the processor's metrics, refreshed a few times per second while
+ * visible, and exports them as CSV.
+ */
+class DiagnosticsView : public juce::Component,
+                        private juce::Timer
+{
+public:
+    explicit DiagnosticsView(PluginProcessor& processor);
+    ~DiagnosticsView() override = default;
+
+    void paint(juce::Graphics& g) override;
+    void resized() override;
+    void visibilityChanged() override;
+
+private:
+    PluginProcessor& processor_;
+    Metrics metrics_;
+    juce::TextButton exportButton_ { "Export..." };
+    std::unique_ptr<juce::FileChooser> fileChooser_;
+
+    void exportMetrics();
+    void timerCallback() override;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(DiagnosticsView)
+};
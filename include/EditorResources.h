@@ -0,0 +1,47 @@
+#pragma once
+
+#include <juce_gui_basics/juce_gui_basics.h>
+#include <vector>
+
+/**
+ * EditorResources
+ * The background artwork, shared by every editor in the process through
+ * juce::SharedResourcePointer. The SVG is parsed once, and each size and
+ * display scale is rasterised once; editors hold cheap references to the
+ * images. Message thread only.
+ */
+class EditorResources
+{
+public:
+    EditorResources();
+
+    /** Background without the title, and the title alone as an alpha mask */
+    struct Images
+    {
+        juce::Image background;
+        juce::Image titleMask;
+        juce::Rectangle<int> titleArea;     // title bounds in editor coordinates
+        int width = 0;
+        int height = 0;
+        float scale = 0.0f;
+    };
+
+    bool hasBackground() const { return background_ != nullptr; }
+    bool hasTitle() const { return titlePath_ != nullptr; }
+
+    /** Images for an editor of the given size and display scale */
+    const Images& getImages(int width, int height, float scale);
+
+private:
+    static constexpr size_t kMaxCachedSizes = 8;
+
+    std::unique_ptr<juce::Drawable> background_;
+    juce::DrawableShape* titlePath_ = nullptr;
+    std::vector<Images> cache_;     // most recently rendered last
+
+    Images render(int width, int height, float scale);
+    static juce::Component* findChildWithIdRecursively(juce::Component& parent, juce::StringRef id);
+    static juce::Rectangle<int> getOpaqueBounds(const juce::Image& image);
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(EditorResources)
+};
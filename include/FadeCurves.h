@@ -0,0 +1,86 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+
+/**
+ * FadeCurves
+ * Gain curves for CrossFader, sampled at compile time. Each table maps the
+ * linear fade position (0 = silent, 1 = unity) to a gain, with exact 0 and 1
+ * at the ends and one guard entry so lookups can interpolate without a
+ * bounds check.
+ */
+namespace FadeCurves
+{
+    constexpr int kTableSize = 256;
+    using Table = std::array<float, kTableSize + 1>;
+
+    namespace detail
+    {
+        constexpr double kPi = 3.14159265358979323846;
+        constexpr double kLn10 = 2.30258509299404568402;
+
+        // Taylor series, accurate to double precision for |x| <= pi/2
+        constexpr double sine(double x)
+        {
+            double term = x, sum = x;
+            for (int n = 1; n < 12; ++n)
+            {
+                term *= -x * x / static_cast<double>((2 * n) * (2 * n + 1));
+                sum += term;
+            }
+            return sum;
+        }
+
+        // Taylor series after halving the argument into [-0.5, 0.5]
+        constexpr double exponential(double x)
+        {
+            int halvings = 0;
+            while (x > 0.5 || x < -0.5)
+            {
+                x *= 0.5;
+                ++halvings;
+            }
+
+            double term = 1.0, sum = 1.0;
+            for (int n = 1; n < 20; ++n)
+            {
+                term *= x / static_cast<double>(n);
+                sum += term;
+            }
+
+            while (halvings-- > 0)
+                sum *= sum;
+            return sum;
+        }
+
+        template <typename Curve>
+        constexpr Table makeTable(Curve curve)
+        {
+            Table table {};
+            for (int i = 0; i <= kTableSize; ++i)
+                table[static_cast<size_t>(i)] = static_cast<float>(curve(static_cast<double>(i) / kTableSize));
+
+            table[0] = 0.0f;
+            table[kTableSize] = 1.0f;
+            return table;
+        }
+    }
+
+    /** Constant power for uncorrelated material: sin(p * pi / 2) */
+    inline constexpr Table equalPower = detail::makeTable([](double p) {
+        return detail::sine(p * detail::kPi * 0.5);
+    });
+
+    /** Linear in decibels over a 60 dB range, pulled down to exact silence */
+    inline constexpr Table exponential = detail::makeTable([](double p) {
+        constexpr double silence = 0.001;
+        return (detail::exponential(-3.0 * detail::kLn10 * (1.0 - p)) - silence) / (1.0 - silence);
+    });
+
+    /** Raised cosine, smooth at both ends: sin^2(p * pi / 2) */
+    inline constexpr Table sCurve = detail::makeTable([](double p) {
+        const double s = detail::sine(p * detail::kPi * 0.5);
+        return s * s;
+    });
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <juce_core/juce_core.h>
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+/**
+ * LinkRegistry
+ * Link groups shared by every processor in the process through
+ * juce::SharedResourcePointer. The instances in a link switch together: the
+ * first one to process a block leads it, decodes its MIDI and publishes the
+ * block's mute and program decisions, and the others apply those decisions
+ * at the same sample positions instead of debouncing and matching MIDI
+ * themselves.
+ *
+ * Decisions are stamped with the host's block time and kept for the last
+ * kNumBlocks blocks, numbered in publishing order. A follower takes every
+ * block it hasn't seen yet: its own block's decisions on their samples, and
+ * those of a block it ran ahead of, when the host processed it before the
+ * leader, at the start of the next one. Each block is a seqlock over atomic
+ * words: neither side blocks or allocates, and a reader that races the
+ * writer gets the block a block later.
+ */
+class LinkRegistry
+{
+public:
+    static constexpr int kNumLinks = 8;
+    static constexpr int kMaxDecisions = 64;    // per block
+    static constexpr int kNumBlocks = 4;        // kept for late followers
+    static constexpr int kNoProgram = -1;
+    static constexpr int kMaxPrograms = 64;
+
+    /** Mutes or unmutes a group, or switches to a program if it has one */
+    struct Decision
+    {
+        int samplePosition = 0;
+        int group = 0;
+        bool muted = false;
+        int program = kNoProgram;
+    };
+
+    class Link
+    {
+    public:
+        /** Audio thread: true for the first instance to process the block
+            stamped stamp, which then leads that block */
+        bool claim(juce::uint64 stamp);
+
+        /** Leader: the decisions of the block stamped stamp, possibly none.
+            Returns the number of blocks published, this one included. */
+        juce::uint64 publish(juce::uint64 stamp, const Decision* decisions, int count);
+
+        /** Blocks published so far; block n is the n-th, from 0 */
+        juce::uint64 getNumPublished() const { return numPublished_.load(std::memory_order_acquire); }
+
+        /** Follower: copies up to maxDecisions decisions of block n and
+            returns how many it has, or -1 if it is being written or has been
+            overwritten */
+        int read(juce::uint64 n, juce::uint64& stamp, Decision* decisions, int maxDecisions) const;
+
+    private:
+        static uint32_t pack(const Decision& decision);
+        static Decision unpack(uint32_t packed);
+
+        std::atomic<juce::uint64> claimed_ { 0 };  // stamp of the last block led
+        std::atomic<juce::uint64> numPublished_ { 0 };
+
+        struct Block
+        {
+            std::atomic<uint32_t> sequence { 0 };  // odd while the leader writes
+            std::atomic<juce::uint64> number { 0 };    // n + 1, 0 before any
+            std::atomic<juce::uint64> stamp { 0 };
+            std::atomic<int> count { 0 };
+            std::array<std::atomic<uint32_t>, kMaxDecisions> decisions {};
+        };
+
+        std::array<Block, kNumBlocks> blocks_ {};
+    };
+
+    /** Link 0 to kNumLinks - 1 */
+    Link& getLink(int index) { return links_[static_cast<size_t>(index)]; }
+
+private:
+    std::array<Link, kNumLinks> links_;
+};
@@ -0,0 +1,83 @@
+#pragma once
+
+#include "TriggerMap.h"
+#include <juce_core/juce_core.h>
+#include <array>
+
+/**
+ * Metrics
+ * Counters of one processor instance, collected on the audio thread and
+ * published once per block as a consistent copy (see
+ * PluginProcessor::getMetrics()). Plain data, so copying never allocates.
+ */
+struct Metrics
+{
+    // processBlock durations: bucket 0 is under 1 us, bucket b covers
+    // [2^(b-1), 2^b) us and the last bucket everything longer
+    static constexpr int kNumTimingBuckets = 16;
+
+    std::array<juce::uint64, kNumTimingBuckets> blockTimes {};
+    juce::uint64 blocks = 0;
+    double maxBlockMicros = 0.0;
+
+    // MIDI messages seen, and trigger firings let through or dropped by
+    // the debouncer
+    juce::uint64 midiSeen = 0;
+    juce::uint64 midiAccepted = 0;
+    juce::uint64 midiRejected = 0;
+
+    // Messages past the per-block limit, which are neither matched nor learnt
+    juce::uint64 midiDropped = 0;
+
+    // Accepted events that matched a trigger, per action (0=stop, 1=go)
+    std::array<juce::uint64, TriggerMap::kNumActions> triggerMatches {};
+
+    // Blocks whose mute decisions came from the link's leader
+    juce::uint64 linkedBlocks = 0;
+
+    // Leader decisions applied at the start of the next block, because
+    // this instance ran before the leader had published them
+    juce::uint64 lateLinkDecisions = 0;
+
+    // Learnt keys lost because the timer hadn't collected earlier ones yet
+    juce::uint64 learnDropped = 0;
+
+    // Samples from a stop trigger to the first silent output sample,
+    // counted in the trigger's timeline (so 0 with lookahead)
+    juce::uint64 silenceLatencyCount = 0;
+    int lastSilenceLatency = 0;
+    int maxSilenceLatency = 0;
+
+    void addBlockTime(double micros);
+    void addSilenceLatency(int samples);
+
+    static int getTimingBucket(double micros);
+    static juce::String getTimingBucketName(int bucket);
+
+    /** Calls visit(name, value) for every metric, in display order */
+    template <typename Visitor>
+    void visit(Visitor&& visit) const
+    {
+        visit("blocks", juce::String(blocks));
+        visit("block_time_max_us", juce::String(maxBlockMicros, 1));
+        for (int b = 0; b < kNumTimingBuckets; ++b)
+            visit("block_time_" + getTimingBucketName(b), juce::String(blockTimes[static_cast<size_t>(b)]));
+
+        visit("midi_seen", juce::String(midiSeen));
+        visit("midi_accepted", juce::String(midiAccepted));
+        visit("midi_rejected", juce::String(midiRejected));
+        visit("midi_dropped", juce::String(midiDropped));
+        visit("stop_matches", juce::String(triggerMatches[0]));
+        visit("go_matches", juce::String(triggerMatches[1]));
+        visit("linked_blocks", juce::String(linkedBlocks));
+        visit("late_link_decisions", juce::String(lateLinkDecisions));
+        visit("learn_dropped", juce::String(learnDropped));
+
+        visit("silence_latency_count", juce::String(silenceLatencyCount));
+        visit("silence_latency_last_samples", juce::String(lastSilenceLatency));
+        visit("silence_latency_max_samples", juce::String(maxSilenceLatency));
+    }
+
+    /** "metric,value" lines with a header, for exporting */
+    juce::String toCsv() const;
+};
@@ -1,18 +1,84 @@
 #pragma once
 
 #include <juce_audio_basics/juce_audio_basics.h>
+#include <array>
+#include <atomic>
+#include <cstdint>
 
+/**
+ * MidiDebouncer
+ * Drops retriggers: a trigger that fires the same action again within the
+ * action's window of its last accepted firing is ignored, so a bouncing
+ * switch acts once while other triggers stay live.
+ *
+ * Times are on the processor's absolute sample clock, which advances by the
+ * real length of every block, so decisions depend only on when events
+ * happen and not on how the host splits them into blocks.
+ */
 class MidiDebouncer
 {
 public:
-    /** Initialize the debouncer */
-    void prepare(double sampleRate, int samplesPerBlock, int ignoreTimeMs);
+    static constexpr int kMaxEventsPerBlock = 256;
+    static constexpr int kNumActions = 2;
+    static constexpr int kDefaultWindowMs = 10;
 
-    /** Call this every block, returns pointer to first allowed MIDI message */
-    std::optional<juce::MidiMessage> processBlock(const juce::MidiBuffer& midi);
+    /**
+     * Candidate events of the last processBlock() call, in buffer order.
+     * Points into the MidiBuffer that was passed in, so it is only valid
+     * until that buffer is modified.
+     */
+    struct Events
+    {
+        const juce::MidiMessageMetadata* first = nullptr;
+        int count = 0;
+        int seen = 0;       // every message in the buffer
+        int dropped = 0;    // candidates past kMaxEventsPerBlock, ignored
+
+        const juce::MidiMessageMetadata* begin() const { return first; }
+        const juce::MidiMessageMetadata* end() const { return first + count; }
+        int size() const { return count; }
+        bool isEmpty() const { return count == 0; }
+    };
+
+    MidiDebouncer();
+
+    /** Sets the rate windows are converted at and forgets past triggers */
+    void prepare(double sampleRate);
+
+    /** Forgets past triggers */
+    void reset();
+
+    /** Window per action (0=stop, 1=go), in ms. Any thread. */
+    void setWindow(int action, int windowMs);
+    int getWindow(int action) const;
+
+    /** Call this every block, returns every message except note offs.
+        Nothing is dropped here: chords and composite messages arrive in
+        bursts, so the windows apply to what they trigger. */
+    Events processBlock(const juce::MidiBuffer& midi);
+
+    /** Whether trigger may fire action at time, in samples; accepting it
+        restarts its window. Call in time order. */
+    bool accept(int32_t trigger, int action, juce::int64 time);
 
 private:
-    int samplesPerBlock_ = 1;
-    juce::int64 ignoreSamples_ = 0;     // number of samples to ignore after first message
-    juce::int64 samplesSinceLast_ = 0;  // tracks how many samples passed since last allowed
+    // Direct mapped by trigger and action. A collision forgets the older
+    // trigger, which can then at worst fire once inside its window.
+    static constexpr int kNumSlots = 64;
+    static_assert(kNumSlots == 64, "slotIndex() yields 6 bits");
+
+    struct Slot
+    {
+        int32_t trigger = -1;
+        int action = 0;
+        juce::int64 time = 0;   // last accepted firing
+    };
+
+    static size_t slotIndex(int32_t trigger, int action);
+
+    double sampleRate_ = 44100.0;
+    std::array<std::atomic<int>, kNumActions> windowMs_;
+    std::array<Slot, kNumSlots> slots_ {};
+
+    std::array<juce::MidiMessageMetadata, kMaxEventsPerBlock> events_;
 };
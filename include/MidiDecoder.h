@@ -0,0 +1,70 @@
+#pragma once
+
+#include <juce_audio_basics/juce_audio_basics.h>
+#include <array>
+#include <cstdint>
+
+/**
+ * MidiDecoder
+ * Turns incoming messages into trigger keys. Every message yields its raw
+ * key, (status << 8) | data1. NRPN/RPN data entry and the LSB half of a
+ * 14-bit controller additionally yield a composite key, which lives above
+ * the 16-bit raw range as (kind << 24) | (channel << 16) | number. Each key
+ * comes with its value: data2 for a raw key, 14 bits for a composite one.
+ * Data entry MSB yields the (N)RPN with a zero LSB; a data entry LSB that
+ * follows yields it again with the full value, as a refinement.
+ *
+ * Composite messages span several controllers, so the decoder keeps a little
+ * state per channel and has to see every message, in order. Audio thread
+ * only; decode() is O(1) and never allocates.
+ */
+class MidiDecoder
+{
+public:
+    enum class Kind { raw = 0, nrpn = 1, rpn = 2, cc14 = 3 };
+
+    static int32_t makeKey(Kind kind, int channel, int number)
+    {
+        return (static_cast<int32_t>(kind) << 24) | ((channel & 0x0F) << 16) | (number & 0x3FFF);
+    }
+
+    static Kind getKind(int32_t key) { return key > 0xFFFF ? static_cast<Kind>(key >> 24) : Kind::raw; }
+
+    /** Channel 0-15 and parameter/controller number of a composite key */
+    static int getChannel(int32_t key) { return (key >> 16) & 0x0F; }
+    static int getNumber(int32_t key) { return key & 0x3FFF; }
+
+    /** Raw key first, then the composite key if the message completed one */
+    struct Keys
+    {
+        std::array<int32_t, 2> keys {};
+        std::array<int, 2> values {};
+        int count = 0;
+        bool partial = false;   // the raw key is only a piece of a composite message
+        bool refinement = false; // the composite key repeats the last one with a finer value
+
+        const int32_t* begin() const { return keys.data(); }
+        const int32_t* end() const { return keys.data() + count; }
+    };
+
+    void reset();
+    Keys decode(const juce::MidiMessageMetadata& msg);
+
+private:
+    struct Channel
+    {
+        // Selected (N)RPN parameter; 0x7F7F is the null parameter
+        Kind parameterKind = Kind::nrpn;
+        int parameter = 0x3FFF;
+
+        // Data entry MSB of the selected parameter, once one has arrived
+        bool hasData = false;
+        uint8_t dataMsb = 0;
+
+        // Controllers 0-31 whose MSB arrived and still waits for its LSB
+        uint32_t pendingMsb = 0;
+        std::array<uint8_t, 32> msbValues {};
+    };
+
+    std::array<Channel, 16> channels_;
+};
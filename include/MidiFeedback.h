@@ -0,0 +1,70 @@
+#pragma once
+
+#include <juce_audio_basics/juce_audio_basics.h>
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+/**
+ * MidiFeedback
+ * Messages sent to controllers when a group's shown state changes, so that
+ * pad and foot switch LEDs follow mute and learn state. Each state has up
+ * to kMaxMessages configured messages, set from the message thread through
+ * atomics.
+ *
+ * The audio thread calls update() wherever a state may have changed; a state
+ * is only sent when it differs from the one last sent for the group. Queued
+ * messages wait in a fixed pool while the input buffer is still being read
+ * and are added to it by flush(), each on the sample of its change.
+ */
+class MidiFeedback
+{
+public:
+    enum class State { muted, unmuted, learningStop, learningGo };
+    static constexpr int kNumStates = 4;
+    static constexpr int kMaxMessages = 2;      // per state
+    static constexpr int kNumGroups = 8;
+    static constexpr int kPoolSize = 64;
+
+    /** A channel message's bytes and their count in one word; 0 is none */
+    static uint32_t pack(const juce::MidiMessage& message);
+
+    // Packed messages of one group, per state and slot
+    using Messages = std::array<std::array<uint32_t, kMaxMessages>, kNumStates>;
+
+    // Message thread
+    void setMessage(int group, State state, int slot, uint32_t packed);
+    uint32_t getMessage(int group, State state, int slot) const;
+
+    /** Replaces all of a group's messages as one change, sent once */
+    void setMessages(int group, const Messages& messages);
+    Messages getMessages(int group) const;
+    bool hasMessages(int group) const;
+
+    // Audio thread
+
+    /** Forgets what was sent, so that every group sends its state again */
+    void reset();
+
+    /** Queues the state's messages at samplePosition if it wasn't the last sent */
+    void update(int group, State state, int samplePosition);
+
+    /** Adds the queued messages to midi and empties the pool */
+    void flush(juce::MidiBuffer& midi);
+
+private:
+    std::array<std::array<std::array<std::atomic<uint32_t>, kMaxMessages>, kNumStates>, kNumGroups> messages_ {};
+    std::atomic<uint32_t> configVersion_ { 0 };
+
+    // Audio thread only
+    struct Pending
+    {
+        int samplePosition = 0;
+        uint32_t packed = 0;
+    };
+
+    std::array<int, kNumGroups> sent_ {};       // State last sent, or -1
+    uint32_t sentVersion_ = 0;
+    std::array<Pending, kPoolSize> pool_ {};
+    int numPending_ = 0;
+};
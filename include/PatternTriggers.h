@@ -0,0 +1,111 @@
+#pragma once
+
+#include <juce_core/juce_core.h>
+#include <array>
+#include <cstdint>
+
+/**
+ * PatternTriggers
+ * Triggers made of up to kMaxSteps keys (see MidiDecoder) that must all
+ * arrive within a window of milliseconds: in any order for a chord, in the given
+ * order for a sequence. A single-step pattern is a plain trigger for keys
+ * the TriggerMap bitmap can't hold, such as NRPNs.
+ *
+ * Set is edited on the message thread, where every change recompiles an
+ * index from key to the pattern steps waiting for it. Matcher is the audio
+ * thread state machine: one probe of that index per key, then bit-parallel
+ * updates of the patterns the key belongs to, so the cost of an event
+ * doesn't depend on the history or on unrelated patterns.
+ */
+namespace PatternTriggers
+{
+    constexpr int kMaxPatterns = 32;
+    constexpr int kMaxSteps = 4;
+    constexpr int kNoAction = -1;
+
+    struct Pattern
+    {
+        std::array<int32_t, kMaxSteps> keys {};
+        int numSteps = 0;
+        bool ordered = false;       // sequence rather than chord
+        int action = 0;             // 0 = stop, 1 = go
+        int windowMs = 0;           // first to last step
+
+        /** Same keys in the same kind of pattern, whatever the action */
+        bool hasSameSteps(const Pattern& other) const;
+    };
+
+    class Set
+    {
+    public:
+        /** Adds a pattern, or rebinds one with the same steps. Returns false
+            when the set is full or the pattern has no steps. */
+        bool add(const Pattern& pattern);
+        void clear(int action);
+        void clearAll();
+
+        int size() const { return numPatterns_; }
+        const Pattern& operator[](int index) const { return patterns_[static_cast<size_t>(index)]; }
+
+        // Audio thread, read through a published TriggerMap::Table
+
+        /** Pattern steps that wait for a key, or nullptr if none does.
+            Step s of pattern p is bit (p % 16) * 4 + s of word p / 16. */
+        const std::array<uint64_t, 2>* lookup(int32_t key) const;
+
+        // Step bits of chords and of sequences, all steps of each pattern
+        const std::array<uint64_t, 2>& getChordSteps() const { return chordSteps_; }
+        const std::array<uint64_t, 2>& getSequenceSteps() const { return sequenceSteps_; }
+
+        /** Changes with every edit, so matchers can drop stale progress */
+        uint32_t getGeneration() const { return generation_; }
+
+    private:
+        // Open addressing, at most half full with kMaxPatterns * kMaxSteps keys
+        static constexpr int kIndexSize = 2 * kMaxPatterns * kMaxSteps;
+        static_assert(kIndexSize == 256, "hash() yields 8 bits");
+        static constexpr int32_t kEmptyKey = -1;
+
+        struct Slot
+        {
+            int32_t key = kEmptyKey;
+            std::array<uint64_t, 2> steps {};
+        };
+
+        static int hash(int32_t key);
+        void compile();
+
+        std::array<Pattern, kMaxPatterns> patterns_ {};
+        int numPatterns_ = 0;
+
+        std::array<Slot, kIndexSize> index_ {};
+        std::array<uint64_t, 2> chordSteps_ {};
+        std::array<uint64_t, 2> sequenceSteps_ {};
+        uint32_t generation_ = 0;
+    };
+
+    class Matcher
+    {
+    public:
+        /** Sets the rate windows are converted at and forgets progress */
+        void prepare(double sampleRate);
+        void reset();
+
+        /** Advances every pattern waiting for key at an absolute sample time.
+            Returns the action of a completed pattern, stop before go, or
+            kNoAction. */
+        int process(const Set& set, int32_t key, juce::int64 time);
+
+        /** Ends the process() calls of one event. Patterns they completed
+            start over if the event fired; otherwise they stay complete, so
+            their last key can fire them again while the window lasts. */
+        void finish(bool fired);
+
+    private:
+        double sampleRate_ = 44100.0;
+        std::array<uint64_t, 2> received_ {};
+        std::array<uint64_t, 2> completed_ {};
+        std::array<juce::int64, kMaxPatterns> started_ {};
+        uint32_t generation_ = 0;
+    };
+}
@@ -10,6 +10,8 @@
 
 #include <juce_audio_processors/juce_audio_processors.h>
 #include <juce_gui_extra/juce_gui_extra.h>
+#include "DiagnosticsView.h"
+#include "EditorResources.h"
 #include "LongPressButton.h"
 #include "PluginProcessor.h"
 
@@ -27,14 +29,36 @@ public:
 private:
     PluginProcessor& audioProcessor_;
 
-    std::unique_ptr<juce::Drawable> background_;
-    juce::DrawableShape* titlePath_ = nullptr;
+    // Shared artwork; the title mask is filled with titleColour_
+    juce::SharedResourcePointer<EditorResources> resources_;
+    EditorResources::Images images_;
+    juce::Colour titleColour_;
     LongPressButton stopButton_;
     LongPressButton goButton_;
+    juce::ComboBox groupSelector_;
+    juce::ComboBox shapeSelector_;
+    juce::ComboBox learnModeSelector_;
+    juce::ComboBox programSelector_;
+    juce::ComboBox programChangeSelector_;
+    juce::ComboBox linkSelector_;
+    juce::ToggleButton lookaheadButton_ { "Lookahead" };
+    juce::ToggleButton feedbackButton_ { "LED feedback" };
+    juce::TextButton diagnosticsButton_ { "Diagnostics" };
+    DiagnosticsView diagnostics_;   // covers the buttons while shown
+    int group_ = 0;     // mute group shown and edited by the buttons
 
+    // Polls the processor's state version once per frame
+    juce::uint32 shownVersion_ = 0;
+    juce::VBlankAttachment vblank_ { this, [this] { pollState(); } };
+
+    void pollState();
     void updateButtons();
     static juce::String formatTrigger(int32_t trigger);
-    static juce::String formatTriggers(std::function<int32_t(int)> getter, int count);
+    static juce::String formatPattern(const PatternTriggers::Pattern& pattern);
+    static juce::String formatValueTrigger(const ValueTriggers::Trigger& trigger);
+    static juce::String formatTriggers(const juce::Array<int32_t>& triggers,
+                                       const juce::Array<PatternTriggers::Pattern>& patterns,
+                                       const juce::Array<ValueTriggers::Trigger>& values);
 
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(PluginEditor)
 };
@@ -9,15 +9,26 @@
 #pragma once
 
 #include "CrossFader.h"
+#include "DelayLine.h"
+#include "LinkRegistry.h"
+#include "Metrics.h"
 #include "MidiDebouncer.h"
+#include "MidiDecoder.h"
+#include "MidiFeedback.h"
+#include "PatternTriggers.h"
+#include "SeqLock.h"
+#include "SpscQueue.h"
+#include "TriggerMap.h"
+#include "ValueTriggers.h"
 #include <juce_audio_processors/juce_audio_processors.h>
 #include <juce_core/juce_core.h>
 #include <array>
 #include <atomic>
+#include <memory>
 
 //==============================================================================
 class PluginProcessor : public juce::AudioProcessor,
-                                 public juce::AsyncUpdater
+                        private juce::Timer
 {
 public:
     //==============================================================================
@@ -33,6 +44,12 @@ public:
    #endif
 
     void processBlock(juce::AudioBuffer<float>&, juce::MidiBuffer&) override;
+    void processBlock(juce::AudioBuffer<double>&, juce::MidiBuffer&) override;
+    void processBlockBypassed(juce::AudioBuffer<float>&, juce::MidiBuffer&) override;
+    void processBlockBypassed(juce::AudioBuffer<double>&, juce::MidiBuffer&) override;
+    bool supportsDoublePrecisionProcessing() const override;
+
+    juce::AudioProcessorParameter* getBypassParameter() const override;
 
     //==============================================================================
     juce::AudioProcessorEditor* createEditor() override;
@@ -58,57 +75,398 @@ public:
     void setStateInformation(const void* data, int sizeInBytes) override;
 
     //==============================================================================
-    // Callback when state changes
-    std::function<void()> onStateChanged;
+    // Bumped whenever state shown by the GUI changes, from any thread. The
+    // GUI polls it instead of being notified, so the audio thread never
+    // touches the message queue.
+    juce::uint32 getStateVersion() const;
+
+    // Each mute group gates one bus pair with its own fader and triggers.
+    // Group 0 is the main bus, the others are optional aux buses.
+    static constexpr int kNumGroups = 8;
+
+    // Read triggers for display, packed as (status << 8) | data1
+    juce::Array<int32_t> getTriggers(int group, int button) const;
+
+    // Chords, sequences and composite (NRPN, RPN, 14-bit CC) triggers
+    juce::Array<PatternTriggers::Pattern> getPatterns(int group, int button) const;
 
-    // Read trigger value for display (returns -1 if unassigned)
-    int32_t getStopTrigger(int slot) const;
-    int32_t getGoTrigger(int slot) const;
+    // Velocity/value ranges and controller threshold crossings
+    juce::Array<ValueTriggers::Trigger> getValueTriggers(int group, int button) const;
 
-    // Clear all triggers for a button (0=stop, 1=go)
-    void clearTriggers(int button);
+    // Assign or clear triggers for a button (0=stop, 1=go)
+    void addTrigger(int group, int button, int32_t trigger);
+    void clearTriggers(int group, int button);
 
     // Access muted state from GUI
-    bool isMuted() const;
-    void setMuted(bool muted);
+    bool isMuted(int group) const;
+    void setMuted(int group, bool muted);
+
+    // MIDI learn: -1 = off, 0 = learning stop, 1 = learning go.
+    // Setters may be called from any thread; the audio thread picks the
+    // latest state up at the top of its next block.
+    int getMidiLearnTarget(int group) const;
+    void setMidiLearnTarget(int group, int target);
+
+    // What learning records: each message as its own trigger, the
+    // messages of one gesture as a chord (any order) or a sequence, or
+    // the values of one gesture as a range or threshold crossing
+    enum class LearnMode { single, chord, sequence, threshold };
+    LearnMode getLearnMode() const;
+    void setLearnMode(LearnMode mode);
+
+    // Time from a pattern's first to last message, in ms, for patterns
+    // learnt from now on
+    int getPatternWindow() const;
+    void setPatternWindow(int ms);
+
+    static constexpr int kDefaultPatternWindowMs = 500;
+
+    // A trigger firing an action again within the action's debounce time
+    // (0=stop, 1=go) is ignored. A gesture learnt in single mode lasts as
+    // long.
+    int getDebounceTime(int action) const;
+    void setDebounceTime(int action, int ms);
+
+    // Fade shape shared by all groups
+    CrossFader::Shape getFadeShape() const;
+    void setFadeShape(CrossFader::Shape shape);
+
+    // Lookahead delays the audio by the fade time so that fades end on the
+    // trigger's sample instead of starting there. Reported as latency.
+    bool isLookaheadEnabled() const;
+    void setLookahead(bool enabled);
+
+    // MIDI sent when a group's state changes, for controller LEDs. Up to
+    // MidiFeedback::kMaxMessages messages per state; an empty message
+    // clears the slot.
+    void setFeedbackMessage(int group, MidiFeedback::State state, int slot, const juce::MidiMessage& message);
+    bool hasFeedback(int group) const;
+
+    // Feedback that lights the group's first stop trigger while muted and
+    // its first go trigger while playing (half lit while learning), or none.
+    // It follows the current program's triggers until a message is set.
+    void setFeedbackFromTriggers(int group, bool enabled);
+    bool isFeedbackFromTriggers(int group) const;
+
+    // Instances in the same link group (1..LinkRegistry::kNumLinks, 0 for
+    // none) mute and unmute together, on the same samples: one decodes MIDI
+    // for all of them. Needs a host that reports block times.
+    int getLinkGroup() const;
+    void setLinkGroup(int link);
+
+    // Programs are snapshots of every group's triggers, kept side by side
+    // so switching is a pointer swap on the audio thread. Triggers are
+    // learnt into, edited in and shown from the current program, whose
+    // tables are allocated when it is first edited.
+    static constexpr int kNumPrograms = 8;
 
-    // MIDI learn: -1 = off, 0 = learning stop, 1 = learning go
-    int getMidiLearnTarget() const;
-    void setMidiLearnTarget(int target);
+    // Program Change messages on this channel (1-16, kProgramChangeAny for
+    // all, kProgramChangeOff for none) select programs 1..kNumPrograms.
+    // They are matched as triggers of the outgoing program first.
+    int getProgramChangeChannel() const;
+    void setProgramChangeChannel(int channel);
 
-    void handleAsyncUpdate() override;
+    static constexpr int kProgramChangeOff = 0;
+    static constexpr int kProgramChangeAny = 17;
 
-    static constexpr int kMaxTriggers = 5;
+    // Latest metrics published by the audio thread, from any thread. Never
+    // waits for the audio thread or other readers.
+    Metrics getMetrics() const;
+
+    // Widest bus layout accepted, e.g. 7th order ambisonics
+    static constexpr int kMaxChannels = 64;
+
+    // Host-automatable parameters: one mute per group ("mute1".."mute8"),
+    // the fade time in ms ("fadeTime") and "bypass". Mute parameters act on
+    // their changes, so MIDI triggers and the GUI can still override them.
+    juce::AudioProcessorValueTreeState parameters;
+
+    static constexpr int kDefaultFadeTimeMs = 50;
+    static constexpr int kMaxFadeTimeMs = 1000;
 
 private:
     //==============================================================================
-    MidiDebouncer midiDebouncer_;
-    CrossFader crossFader_;
-    // MIDI learn: -1 = off, 0 = learning stop, 1 = learning go
-    std::atomic<int> midiLearnTarget_ { -1 };
-    std::atomic<bool> muted_ { false };
-
-    // MIDI triggers. -1 means unassigned.
-    // Packed as (status << 8) | data1, ignoring velocity/value.
-    static constexpr int32_t kUnassignedTrigger = -1;
-    std::array<std::atomic<int32_t>, 5> stopTriggers_ {
-        kUnassignedTrigger, kUnassignedTrigger, kUnassignedTrigger,
-        kUnassignedTrigger, kUnassignedTrigger
+    // Audio thread only, each group on its own cache lines
+    struct alignas(64) Group
+    {
+        CrossFader crossFader;
+        PatternTriggers::Matcher patterns;
+        ValueTriggers::Matcher values;
+        int learnTarget = -1;
+        bool muteParameter = false; // last value seen, to act on changes only
+        int firstChannel = 0;   // bus position in the processBlock buffer
+        int numChannels = 0;
     };
-    std::array<std::atomic<int32_t>, 5> goTriggers_ {
-        kUnassignedTrigger, kUnassignedTrigger, kUnassignedTrigger,
-        kUnassignedTrigger, kUnassignedTrigger
+
+    alignas(64) MidiDebouncer midiDebouncer_;
+    static_assert(MidiDebouncer::kNumActions == TriggerMap::kNumActions);
+    MidiDecoder midiDecoder_;
+    std::array<Group, kNumGroups> groups_;
+    MidiFeedback feedback_;
+    static_assert(MidiFeedback::kNumGroups == kNumGroups);
+
+    // Groups whose feedback is derived from their triggers. The timer
+    // derives it again whenever the state version moves, which every
+    // trigger edit and program switch bumps.
+    std::array<std::atomic<bool>, kNumGroups> feedbackFromTriggers_ {};
+    juce::uint32 feedbackVersion_ = 0;      // message thread
+
+    // Link group in use and the leader's decisions for the current block;
+    // a leader collects its own there before publishing them
+    juce::SharedResourcePointer<LinkRegistry> links_;
+    std::atomic<int> linkGroup_ { 0 };
+    int activeLink_ = 0;
+    std::array<LinkRegistry::Decision, LinkRegistry::kMaxDecisions> linkDecisions_;
+    int numLinkDecisions_ = 0;
+    bool following_ = false;            // in the last block
+    bool leading_ = false;              // in the last block
+    juce::uint64 nextLinkBlock_ = 0;    // first published block not applied
+
+    // Samples processed since construction, the time base of patterns.
+    // Published for the timer, which closes learnt gestures.
+    juce::int64 sampleClock_ = 0;
+    std::atomic<juce::int64> publishedClock_ { 0 };
+
+    // Fade length in use; with lookahead it stays at the prepared length,
+    // which the delay was sized for
+    int fadeTimeMs_ = kDefaultFadeTimeMs;
+    int preparedFadeTimeMs_ = kDefaultFadeTimeMs;
+
+    // Lookahead delay over the whole buffer, prepared for the host's precision.
+    // It only runs with lookahead on or while switching, when the direct
+    // signal fades out and the delayed one fades in after it.
+    bool lookahead_ = false;
+    DelayLine<float> floatDelay_;
+    DelayLine<double> doubleDelay_;
+    CrossFader delayedFader_;
+    CrossFader directFader_;
+
+    template <typename SampleType>
+    DelayLine<SampleType>& getDelay()
+    {
+        if constexpr (std::is_same_v<SampleType, float>)
+            return floatDelay_;
+        else
+            return doubleDelay_;
+    }
+
+    // Bypass crossfades the processed (wet) signal with the input (dry).
+    // Once settled, bypassed blocks skip the audio path entirely; MIDI is
+    // still decoded so debounce timing, mute state and learn carry on.
+    bool bypassed_ = false;
+    CrossFader wetFader_;
+    CrossFader dryFader_;
+    juce::AudioBuffer<float> floatDry_;     // input copy while crossfading
+    juce::AudioBuffer<double> doubleDry_;
+
+    template <typename SampleType>
+    juce::AudioBuffer<SampleType>& getDryBuffer()
+    {
+        if constexpr (std::is_same_v<SampleType, float>)
+            return floatDry_;
+        else
+            return doubleDry_;
+    }
+
+    // Published to / polled by the GUI, and the state other threads ask
+    // for. The audio thread reads the requested state at the top of each
+    // block (applyRequests()), so a request is never lost or replayed out of
+    // order, however many arrive while it isn't processing.
+    static constexpr int kNoRequest = -1;
+
+    struct alignas(64) GroupStatus
+    {
+        // MIDI learn: -1 = off, 0 = learning stop, 1 = learning go
+        std::atomic<int> midiLearnTarget { -1 };
+        std::atomic<bool> muted { false };
+
+        // Mute state asked for since the audio thread last looked: 0 =
+        // unmute, 1 = mute, kNoRequest = none. MIDI changes mute state too,
+        // so unlike the others it is taken rather than mirrored.
+        std::atomic<int> muteRequest { kNoRequest };
+
+        // Set by the audio thread when MIDI or a link changes mute state, for
+        // the timer to copy to the parameter. The timer stores the value
+        // it copies (0, 1 or kNoRequest) first, and the next block takes it,
+        // so that parameter change isn't applied over newer state.
+        std::atomic<bool> muteUnreported { false };
+        std::atomic<int> muteReported { kNoRequest };
+    };
+
+    std::array<GroupStatus, kNumGroups> groupStatus_;
+    std::atomic<CrossFader::Shape> fadeShape_ { CrossFader::Shape::linear };
+    std::atomic<LearnMode> learnMode_ { LearnMode::single };
+    std::atomic<int> patternWindow_ { kDefaultPatternWindowMs };
+    std::atomic<juce::uint32> stateVersion_ { 0 };
+
+    // Parameter values, read lock-free on the audio thread
+    std::array<std::atomic<float>*, kNumGroups> muteValues_ {};
+    std::atomic<float>* fadeTimeValue_ = nullptr;
+    std::atomic<float>* bypassValue_ = nullptr;
+    std::atomic<bool> lookaheadEnabled_ { false };
+    std::atomic<int> lookaheadSamples_ { 0 };   // latency while lookahead is on
+
+    // Collected on the audio thread, published at the end of every block
+    Metrics metrics_;
+    SeqLock<Metrics> publishedMetrics_;
+    const double microsPerTick_ = 1.0e6 / static_cast<double>(juce::Time::getHighResolutionTicksPerSecond());
+
+    // MIDI triggers, keyed by MidiDecoder and ignoring velocity/value.
+    // Edited on the message thread only; learnt keys are passed over from
+    // the audio thread and added by the timer.
+    // Edits, program names and state snapshots are serialised by
+    // triggerLock_, which the audio thread never takes.
+    struct Program
+    {
+        std::array<TriggerMap, kNumGroups> maps;
+    };
+
+    // A program never edited has no tables and reads as empty. Allocated on
+    // the message thread, published through programs_ and kept for the
+    // processor's lifetime.
+    std::array<std::unique_ptr<Program>, kNumPrograms> programStorage_;
+    std::array<std::atomic<Program*>, kNumPrograms> programs_ {};
+    std::array<juce::String, kNumPrograms> programNames_;
+    mutable juce::CriticalSection triggerLock_;
+
+    // Stored by the audio thread on Program Change and by setCurrentProgram()
+    // on any thread; the audio thread reads it at the top of each block and
+    // after each MIDI event and link decision
+    std::atomic<int> currentProgram_ { 0 };
+    static_assert(kNumPrograms <= LinkRegistry::kMaxPrograms);
+    std::atomic<int> programChangeChannel_ { kProgramChangeOff };
+
+    static const TriggerMap::Table& getEmptyTable();
+
+    // Under triggerLock_: a program's maps, allocated if it has none yet,
+    // and the table of one of the current program's groups
+    std::array<TriggerMap, kNumGroups>& getMaps(int program);
+    const TriggerMap::Table& getCurrentTable(int group) const;
+
+    struct LearntTrigger
+    {
+        int group = 0;
+        int button = 0;
+        int32_t trigger = 0;
+        int value = 0;
+        juce::int64 time = 0;   // on the sample clock
+        bool refinement = false; // see MidiDecoder::Keys
+    };
+
+    // Room for two blocks of events at the debouncer's cap, each with a
+    // composite key; the timer drains it. Keys that don't fit are counted
+    // in Metrics::learnDropped.
+    SpscQueue<LearntTrigger, 4 * MidiDebouncer::kMaxEventsPerBlock> learntTriggers_;
+
+    // Timer only: learnt keys of the gesture in progress, per group. A
+    // gesture ends when the window from its first key has passed.
+    struct Gesture
+    {
+        LearnMode mode = LearnMode::single;
+        PatternTriggers::Pattern pattern;
+        int firstValue = 0;     // threshold mode: values of pattern.keys[0]
+        int lastValue = 0;
+        juce::int64 started = 0;
+        juce::int64 windowSamples = 0;  // pattern.windowMs at the current rate
+        bool active = false;
     };
 
-    // Pack MIDI message for matching (ignores velocity/value)
-    static int32_t packMidiForMatch(const juce::MidiMessage& msg);
+    std::array<Gesture, kNumGroups> gestures_;
 
-    // Check if incoming message matches a stored trigger
-    static bool midiMatches(const juce::MidiMessage& incoming, int32_t stored);
+    void addLearnt(const LearntTrigger& trigger);
+    void finishGesture(int group);
+    void addValueTrigger(int group, const Gesture& gesture);
+
+    static BusesProperties createBusesProperties();
+    static juce::AudioProcessorValueTreeState::ParameterLayout createParameterLayout();
+    static juce::String getMuteParameterId(int group);
+
+    // Everything getStateInformation() saves, decoded before it is applied
+    struct State
+    {
+        // Programs without triggers are left out
+        using Tables = std::array<TriggerMap::Table, kNumGroups>;
+        std::array<std::unique_ptr<Tables>, kNumPrograms> programs;
+
+        Tables& getTables(int program)
+        {
+            auto& tables = programs[static_cast<size_t>(program)];
+            if (tables == nullptr)
+                tables = std::make_unique<Tables>();
+            return *tables;
+        }
+
+        const TriggerMap::Table& getTable(int program, int group) const
+        {
+            const auto& tables = programs[static_cast<size_t>(program)];
+            return tables != nullptr ? (*tables)[static_cast<size_t>(group)] : getEmptyTable();
+        }
+
+        std::array<juce::String, kNumPrograms> programNames;
+        int currentProgram = 0;
+        int programChangeChannel = kProgramChangeOff;   // sessions from before programs
+        std::array<bool, kNumGroups> muted {};
+        CrossFader::Shape fadeShape = CrossFader::Shape::linear;
+        bool lookahead = false;
+        int fadeTimeMs = kDefaultFadeTimeMs;
+        LearnMode learnMode = LearnMode::single;
+        int patternWindowMs = kDefaultPatternWindowMs;
+
+        // Packed as MidiFeedback::pack(), per group, state and slot
+        std::array<MidiFeedback::Messages, kNumGroups> feedback {};
+        std::array<bool, kNumGroups> feedbackFromTriggers {};
+
+        int linkGroup = 0;
+        std::array<int, TriggerMap::kNumActions> debounceMs { MidiDebouncer::kDefaultWindowMs, MidiDebouncer::kDefaultWindowMs };
+    };
+
+    // Binary state: magic, version, then the State fields. Version 1 was
+    // XML and is still read.
+    static constexpr int kStateMagic = 0x54464d53;  // "SMFT" little-endian
+    static constexpr int kStateVersion = 2;
+
+    std::unique_ptr<State> captureState() const;
+    void applyState(const State& state);
+    static void writeBinaryState(const State& state, juce::MemoryBlock& destData);
+    static bool readBinaryState(const void* data, int sizeInBytes, State& state);
+    static bool readXmlState(const juce::XmlElement& xml, State& state);
+
+    // One group's triggers of each kind, as laid out in the binary state
+    static void writeTriggers(juce::OutputStream& stream, const TriggerMap::Table& table);
+    static void writePatterns(juce::OutputStream& stream, const TriggerMap::Table& table);
+    static void writeValueTriggers(juce::OutputStream& stream, const TriggerMap::Table& table);
+    static bool readTriggers(juce::InputStream& stream, TriggerMap::Table& table);
+    static bool readPatterns(juce::InputStream& stream, TriggerMap::Table& table);
+    static bool readValueTriggers(juce::InputStream& stream, TriggerMap::Table& table);
 
     //==============================================================================
-    void handleMidi(const juce::MidiBuffer& midi);
-    void processBuffer(juce::AudioBuffer<float>& buffer);
+    void bumpStateVersion();
+    void timerCallback() override;
+    void applyRequests();
+    void updateParameters();
+    void setBypassed(bool bypassed);
+    void applyMuted(int group, bool muted);
+    void applyDecision(int group, bool muted);
+    void requestMuted(int group, bool muted);
+    void reportMutes();
+    void deriveFeedback(int group);
+    void updateFeedback(int samplePosition);
+    LinkRegistry::Link* updateLink();
+    int followLink(LinkRegistry::Link& link, juce::uint64 stamp);
+    juce::uint64 getBlockStamp() const;
+    bool isProgramChange(const juce::MidiMessageMetadata& msg) const;
+    void handleMidi(const juce::MidiMessageMetadata& msg, const TriggerMap::Table* const* triggers);
+    void resetMidiState();
+
+    // Shared by the float and double processBlock(Bypassed) overloads
+    template <typename SampleType>
+    void processAudio(juce::AudioBuffer<SampleType>& buffer, juce::MidiBuffer& midiMessages, bool hostBypassed);
+
+    template <typename SampleType>
+    void processLookahead(juce::AudioBuffer<SampleType>& buffer, juce::AudioBuffer<SampleType>& scratch);
+
+    template <typename SampleType>
+    void processBuffer(juce::AudioBuffer<SampleType>& buffer, int startSample, int numSamples);
 
     //==============================================================================
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(PluginProcessor)
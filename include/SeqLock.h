@@ -0,0 +1,80 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+/**
+ * SeqLock
+ * Single-writer/many-reader handoff of the latest value of a trivially
+ * copyable type. The writer never waits or allocates: it copies the value
+ * into the next of a ring of slots, each guarded by a sequence number, and
+ * only then points readers at it. Readers neither lock nor write, and the
+ * slot they read is never the one being written, so they don't wait for
+ * the writer either. Only a reader that is overtaken by kNumSlots - 1
+ * further writes while it copies has to copy again.
+ */
+template <typename T>
+class SeqLock
+{
+    static_assert(std::is_trivially_copyable_v<T>, "T is copied word by word");
+
+public:
+    /** Writer side: makes value the latest one */
+    void publish(const T& value)
+    {
+        std::array<uint64_t, kNumWords> words {};
+        std::memcpy(words.data(), &value, sizeof(T));
+
+        const auto index = (latest_.load(std::memory_order_relaxed) + 1) % kNumSlots;
+        auto& slot = slots_[index];
+
+        const auto sequence = slot.sequence.load(std::memory_order_relaxed);
+        slot.sequence.store(sequence + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+
+        for (size_t i = 0; i < kNumWords; ++i)
+            slot.words[i].store(words[i], std::memory_order_relaxed);
+
+        slot.sequence.store(sequence + 2, std::memory_order_release);
+        latest_.store(index, std::memory_order_release);
+    }
+
+    /** Reader side, any thread: the latest published value */
+    T read() const
+    {
+        std::array<uint64_t, kNumWords> words {};
+
+        for (;;)
+        {
+            const auto& slot = slots_[latest_.load(std::memory_order_acquire)];
+            const auto before = slot.sequence.load(std::memory_order_acquire);
+
+            for (size_t i = 0; i < kNumWords; ++i)
+                words[i] = slot.words[i].load(std::memory_order_relaxed);
+
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if ((before & 1) == 0 && slot.sequence.load(std::memory_order_relaxed) == before)
+                break;
+        }
+
+        T value;
+        std::memcpy(static_cast<void*>(&value), words.data(), sizeof(T));
+        return value;
+    }
+
+private:
+    static constexpr size_t kNumWords = (sizeof(T) + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+    static constexpr size_t kNumSlots = 4;
+
+    struct alignas(64) Slot
+    {
+        std::atomic<uint32_t> sequence { 0 };  // odd while the writer copies
+        std::array<std::atomic<uint64_t>, kNumWords> words {};
+    };
+
+    std::array<Slot, kNumSlots> slots_ {};
+    std::atomic<size_t> latest_ { 0 };
+};
@@ -0,0 +1,121 @@
+#pragma once
+
+#include "PatternTriggers.h"
+#include "ValueTriggers.h"
+#include <juce_core/juce_core.h>
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+/**
+ * TriggerMap
+ * Maps packed MIDI triggers ((status << 8) | data1) to button actions
+ * (0 = stop, 1 = go) with one bit per status/data1 pair, so a lookup is a
+ * single bit test and each action can hold any number of triggers. Chords,
+ * sequences and composite keys such as NRPNs are kept next to the bitmap as
+ * PatternTriggers, and triggers on values as ValueTriggers; both have their
+ * own per-group matching state.
+ *
+ * The map is double buffered. The message thread is the only writer: it
+ * edits the spare table and publishes it with an atomic pointer swap. An
+ * audio-thread reader may still hold the previous table, which becomes the
+ * next spare, so the next edit waits that reader out first. Edits of many
+ * maps in a row, such as a state load, therefore don't wait at all; only a
+ * second edit of one map within an audio block does. The audio thread never
+ * sees a half-written table.
+ */
+class TriggerMap
+{
+public:
+    static constexpr int kNumActions = 2;
+    static constexpr int32_t kNoAction = -1;
+
+    class Table
+    {
+    public:
+        /** Returns the action bound to a packed trigger, or kNoAction */
+        int lookup(int32_t packed) const;
+
+        /** Binds a trigger to an action, removing it from the other one.
+            Composite keys (see MidiDecoder) become single-step patterns. */
+        void add(int action, int32_t packed);
+        bool addPattern(const PatternTriggers::Pattern& pattern);
+
+        /** Adds a value trigger. It replaces a plain trigger on the same
+            key, which would fire on any value. */
+        bool addValueTrigger(const ValueTriggers::Trigger& trigger);
+
+        void clear(int action);
+        void clearAll();
+        bool isEmpty() const;
+
+        const PatternTriggers::Set& getPatterns() const { return patterns_; }
+        const ValueTriggers::Set& getValueTriggers() const { return values_; }
+
+        /** Triggers bound to an action, in ascending packed order */
+        juce::Array<int32_t> getTriggers(int action) const;
+
+        /** Calls visit(packed) for every trigger of an action, in ascending
+            packed order, skipping empty words of the bitmap */
+        template <typename Visitor>
+        void forEachTrigger(int action, Visitor&& visit) const
+        {
+            if (! juce::isPositiveAndBelow(action, kNumActions))
+                return;
+
+            const auto& bits = bits_[static_cast<size_t>(action)];
+            for (int word = 0; word < kNumWords; ++word)
+            {
+                for (auto remaining = bits[static_cast<size_t>(word)]; remaining != 0; remaining &= remaining - 1)
+                {
+                    const int key = (word << 6) + juce::countNumberOfBits((remaining & (~remaining + 1)) - 1);
+                    visit(((0x80 | (key >> 7)) << 8) | (key & 0x7F));
+                }
+            }
+        }
+
+    private:
+        // One bit per (status 0x80-0xFF, data1 0-127) pair
+        static constexpr int kNumKeys = 128 * 128;
+        static constexpr int kNumWords = kNumKeys / 64;
+
+        static int keyIndex(int32_t packed);
+
+        std::array<std::array<uint64_t, kNumWords>, kNumActions> bits_ {};
+        PatternTriggers::Set patterns_;
+        ValueTriggers::Set values_;
+    };
+
+    /** Audio thread: pins the published table until endRead() */
+    const Table& beginRead();
+    void endRead();
+
+    TriggerMap();
+
+    /** Message thread: the currently published table */
+    const Table& getTable() const;
+
+    /** Message thread: applies editor(Table&) to a copy and publishes it */
+    template <typename Editor>
+    void edit(Editor&& editor)
+    {
+        auto& spare = beginEdit();
+        editor(spare);
+        publish(spare);
+    }
+
+private:
+    Table& beginEdit();
+    void publish(Table& table);
+
+    std::array<Table, 2> tables_;
+    std::atomic<const Table*> current_;
+    std::atomic<uint32_t> readEpoch_ { 0 };    // odd while the audio thread reads
+
+    // Message thread: the read epoch that may still hold the spare table,
+    // or kNoReader
+    static constexpr uint32_t kNoReader = 0;
+    uint32_t spareReader_ = kNoReader;
+
+    JUCE_DECLARE_NON_COPYABLE(TriggerMap)
+};
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <juce_core/juce_core.h>
+#include <array>
+#include <cstdint>
+
+/**
+ * ValueTriggers
+ * Triggers that look at a message's value as well as its key (see
+ * MidiDecoder): a velocity or controller range, or a controller crossing a
+ * threshold in one direction. A crossing fires once and re-arms only after
+ * the value has moved back past the threshold by the hysteresis, so a
+ * jittery fader doesn't fire repeatedly.
+ *
+ * Set is edited on the message thread, where every change recompiles a
+ * per-key table of the rules watching it. Matcher holds the audio thread
+ * state; an event costs one probe of that table plus the rules of its key,
+ * however densely the controller streams.
+ */
+namespace ValueTriggers
+{
+    constexpr int kMaxTriggers = 32;
+    constexpr int kNoAction = -1;
+
+    enum class Mode { range, rising, falling };
+
+    struct Trigger
+    {
+        int32_t key = 0;
+        int action = 0;         // 0 = stop, 1 = go
+        Mode mode = Mode::range;
+        int low = 0;            // range: inclusive bounds
+        int high = 127;
+        int threshold = 64;     // rising/falling: fires on reaching it
+        int hysteresis = 0;     // further back from the threshold to re-arm
+
+        /** Same key and condition, whatever the action */
+        bool hasSameCondition(const Trigger& other) const;
+    };
+
+    class Set
+    {
+    public:
+        /** Adds a trigger, or rebinds one with the same condition. Returns
+            false when the set is full. */
+        bool add(const Trigger& trigger);
+        void clear(int action);
+        void clearAll();
+
+        int size() const { return numTriggers_; }
+        const Trigger& operator[](int index) const { return triggers_[static_cast<size_t>(index)]; }
+
+        // Audio thread, read through a published TriggerMap::Table
+
+        /** One bit per trigger watching the key, 0 if none does */
+        uint32_t lookup(int32_t key) const;
+
+        /** Changes with every edit, so matchers can drop stale state */
+        uint32_t getGeneration() const { return generation_; }
+
+    private:
+        // Open addressing, at most half full with kMaxTriggers keys
+        static constexpr int kIndexSize = 2 * kMaxTriggers;
+        static_assert(kIndexSize == 64, "hash() yields 6 bits");
+        static constexpr int32_t kEmptyKey = -1;
+
+        struct Slot
+        {
+            int32_t key = kEmptyKey;
+            uint32_t triggers = 0;
+        };
+
+        static int hash(int32_t key);
+        void compile();
+
+        std::array<Trigger, kMaxTriggers> triggers_ {};
+        int numTriggers_ = 0;
+
+        std::array<Slot, kIndexSize> index_ {};
+        uint32_t generation_ = 0;
+    };
+
+    class Matcher
+    {
+    public:
+        void reset();
+
+        /** Evaluates the triggers watching key against its new value.
+            Returns the action of one that fired, stop before go, or
+            kNoAction. */
+        int process(const Set& set, int32_t key, int value);
+
+    private:
+        // One bit per trigger
+        uint32_t known_ = 0;    // has seen a value since the last reset
+        uint32_t armed_ = 0;    // crossing: may fire
+        uint32_t inside_ = 0;   // range: last value was inside
+        uint32_t generation_ = 0;
+    };
+}
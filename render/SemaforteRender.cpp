@@ -0,0 +1,254 @@
+/*
+  ==============================================================================
+
+    SemaforteRender
+    Offline batch renderer: streams audio files through PluginProcessor,
+    driven by the events of a matching Standard MIDI File, and writes the
+    gated result as 32-bit float WAV. File pairs are rendered in parallel,
+    one processor per job.
+
+    Usage: SemaforteRender [options] <audio> <midi> [<audio> <midi> ...]
+
+      --out=<dir>       output directory (default: current directory)
+      --jobs=<n>        worker threads (default: number of CPUs)
+      --block=<n>       samples per processBlock call (default: 8192)
+      --stop=<hex,...>  stop triggers, packed as (status << 8) | data1
+      --go=<hex,...>    go triggers, packed the same way
+      --golden=<dir>    compare each output against the file of the same
+                        name in <dir> and fail unless bit-identical
+
+  ==============================================================================
+*/
+
+#include "PluginProcessor.h"
+#include <juce_audio_formats/juce_audio_formats.h>
+#include <juce_core/juce_core.h>
+#include <cstdio>
+#include <mutex>
+#include <vector>
+
+namespace
+{
+    struct Settings
+    {
+        juce::File outputDir;
+        juce::File goldenDir;
+        int blockSize = 8192;
+        juce::Array<int32_t> stopTriggers;
+        juce::Array<int32_t> goTriggers;
+    };
+
+    struct Job
+    {
+        juce::File audio;
+        juce::File midi;
+    };
+
+    juce::Array<int32_t> parseTriggers(const juce::String& list)
+    {
+        juce::Array<int32_t> triggers;
+        for (const auto& token : juce::StringArray::fromTokens(list, ",", ""))
+            if (token.trim().isNotEmpty())
+                triggers.add(token.trim().getHexValue32());
+        return triggers;
+    }
+
+    /** All channel messages of every track, timestamped in seconds */
+    bool readControlEvents(const juce::File& file, juce::MidiMessageSequence& events)
+    {
+        juce::FileInputStream stream(file);
+        juce::MidiFile midiFile;
+        if (! stream.openedOk() || ! midiFile.readFrom(stream))
+            return false;
+
+        midiFile.convertTimestampTicksToSeconds();
+
+        for (int t = 0; t < midiFile.getNumTracks(); ++t)
+            for (const auto* holder : *midiFile.getTrack(t))
+                if (! holder->message.isMetaEvent() && ! holder->message.isSysEx())
+                    events.addEvent(holder->message);
+
+        events.sort();
+        return true;
+    }
+
+    bool filesAreIdentical(const juce::File& a, const juce::File& b, juce::AudioFormatManager& formats)
+    {
+        std::unique_ptr<juce::AudioFormatReader> readerA(formats.createReaderFor(a));
+        std::unique_ptr<juce::AudioFormatReader> readerB(formats.createReaderFor(b));
+        if (readerA == nullptr || readerB == nullptr
+         || readerA->numChannels != readerB->numChannels
+         || readerA->lengthInSamples != readerB->lengthInSamples)
+            return false;
+
+        const int numChannels = static_cast<int>(readerA->numChannels);
+        constexpr int chunk = 65536;
+        juce::AudioBuffer<float> bufferA(numChannels, chunk);
+        juce::AudioBuffer<float> bufferB(numChannels, chunk);
+
+        for (juce::int64 pos = 0; pos < readerA->lengthInSamples; pos += chunk)
+        {
+            const int n = static_cast<int>(juce::jmin(juce::int64 { chunk }, readerA->lengthInSamples - pos));
+            readerA->read(&bufferA, 0, n, pos, true, true);
+            readerB->read(&bufferB, 0, n, pos, true, true);
+
+            for (int ch = 0; ch < numChannels; ++ch)
+                if (std::memcmp(bufferA.getReadPointer(ch), bufferB.getReadPointer(ch), sizeof(float) * static_cast<size_t>(n)) != 0)
+                    return false;
+        }
+        return true;
+    }
+
+    /** Renders one file pair, returning an error message or an empty string */
+    juce::String render(const Job& job, const Settings& settings)
+    {
+        juce::AudioFormatManager formats;
+        formats.registerBasicFormats();
+
+        std::unique_ptr<juce::AudioFormatReader> reader(formats.createReaderFor(job.audio));
+        if (reader == nullptr)
+            return "cannot read " + job.audio.getFullPathName();
+
+        juce::MidiMessageSequence events;
+        if (! readControlEvents(job.midi, events))
+            return "cannot read " + job.midi.getFullPathName();
+
+        const auto output = settings.outputDir.getChildFile(job.audio.getFileNameWithoutExtension() + ".wav");
+        output.deleteFile();
+
+        auto stream = output.createOutputStream();
+        if (stream == nullptr)
+            return "cannot write " + output.getFullPathName();
+
+        const double sampleRate = reader->sampleRate;
+        const int numChannels = static_cast<int>(reader->numChannels);
+
+        juce::WavAudioFormat wav;
+        std::unique_ptr<juce::AudioFormatWriter> writer(
+            wav.createWriterFor(stream.get(), sampleRate, reader->numChannels, 32, {}, 0));
+        if (writer == nullptr)
+            return "cannot write " + output.getFullPathName();
+        stream.release(); // now owned by the writer
+
+        PluginProcessor processor;
+        for (auto trigger : settings.stopTriggers)
+            processor.addTrigger(0, 0, trigger);
+        for (auto trigger : settings.goTriggers)
+            processor.addTrigger(0, 1, trigger);
+
+        processor.setNonRealtime(true);
+        processor.setPlayConfigDetails(numChannels, numChannels, sampleRate, settings.blockSize);
+        processor.prepareToPlay(sampleRate, settings.blockSize);
+
+        juce::AudioBuffer<float> buffer(numChannels, settings.blockSize);
+        juce::MidiBuffer midi;
+        int nextEvent = 0;
+
+        for (juce::int64 pos = 0; pos < reader->lengthInSamples; pos += settings.blockSize)
+        {
+            const int n = static_cast<int>(juce::jmin(juce::int64 { settings.blockSize }, reader->lengthInSamples - pos));
+            buffer.setSize(numChannels, n, false, false, true);
+            reader->read(&buffer, 0, n, pos, true, true);
+
+            midi.clear();
+            for (; nextEvent < events.getNumEvents(); ++nextEvent)
+            {
+                const auto& message = events.getEventPointer(nextEvent)->message;
+                const auto samplePos = static_cast<juce::int64>(std::llround(message.getTimeStamp() * sampleRate));
+                if (samplePos >= pos + n)
+                    break;
+                midi.addEvent(message, static_cast<int>(juce::jmax(juce::int64 { 0 }, samplePos - pos)));
+            }
+
+            processor.processBlock(buffer, midi);
+
+            if (! writer->writeFromAudioSampleBuffer(buffer, 0, n))
+                return "write failed for " + output.getFullPathName();
+        }
+
+        processor.releaseResources();
+        writer.reset();
+
+        if (settings.goldenDir != juce::File())
+        {
+            const auto golden = settings.goldenDir.getChildFile(output.getFileName());
+            if (! filesAreIdentical(output, golden, formats))
+                return output.getFileName() + " differs from " + golden.getFullPathName();
+        }
+
+        return {};
+    }
+}
+
+//==============================================================================
+int main(int argc, char* argv[])
+{
+    // The processor is a Timer, so a message manager has to exist
+    juce::ScopedJuceInitialiser_GUI juceInitialiser;
+
+    juce::ArgumentList args(argc, argv);
+
+    Settings settings;
+    settings.outputDir = args.containsOption("--out") ? args.getFileForOption("--out")
+                                                      : juce::File::getCurrentWorkingDirectory();
+    if (args.containsOption("--golden"))
+        settings.goldenDir = args.getFileForOption("--golden");
+    if (args.containsOption("--block"))
+        settings.blockSize = juce::jmax(1, args.getValueForOption("--block").getIntValue());
+    settings.stopTriggers = parseTriggers(args.getValueForOption("--stop"));
+    settings.goTriggers = parseTriggers(args.getValueForOption("--go"));
+
+    const int numThreads = args.containsOption("--jobs") ? juce::jmax(1, args.getValueForOption("--jobs").getIntValue())
+                                                         : juce::SystemStats::getNumCpus();
+
+    std::vector<Job> jobs;
+    juce::StringArray files;
+    for (const auto& arg : args.arguments)
+        if (! arg.isOption())
+            files.add(arg.text);
+
+    if (files.isEmpty() || files.size() % 2 != 0)
+    {
+        std::fprintf(stderr, "Usage: SemaforteRender [options] <audio> <midi> [<audio> <midi> ...]\n");
+        return 1;
+    }
+
+    for (int i = 0; i < files.size(); i += 2)
+        jobs.push_back({ juce::File::getCurrentWorkingDirectory().getChildFile(files[i]),
+                   juce::File::getCurrentWorkingDirectory().getChildFile(files[i + 1]) });
+
+    const auto created = settings.outputDir.createDirectory();
+    if (created.failed())
+    {
+        std::fprintf(stderr, "%s\n", created.getErrorMessage().toRawUTF8());
+        return 1;
+    }
+
+    std::mutex resultLock;
+    juce::StringArray failures;
+
+    {
+        juce::ThreadPool pool(numThreads);
+
+        for (const auto& job : jobs)
+        {
+            pool.addJob([&, job] {
+                const auto error = render(job, settings);
+
+                const std::lock_guard<std::mutex> lock(resultLock);
+                if (error.isEmpty())
+                    std::printf("ok    %s\n", job.audio.getFileName().toRawUTF8());
+                else
+                    failures.add(error);
+            });
+        }
+
+        while (pool.getNumJobs() > 0)
+            juce::Thread::sleep(10);
+    }
+
+    for (const auto& failure : failures)
+        std::fprintf(stderr, "FAIL  %s\n", failure.toRawUTF8());
+
+    return failures.isEmpty() ? 0 : 1;
+}
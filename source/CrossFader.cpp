@@ -1,22 +1,155 @@
 #include "CrossFader.h"
 
-void CrossFader::prepare(double sampleRate, int fadeTimeMs, float initialGain)
+void CrossFader::prepare(double sampleRate, int fadeTimeMs, int maxBlockSize, float initialGain)
 {
-    fader_.reset(sampleRate, fadeTimeMs / 1000.0);
-    fader_.setCurrentAndTargetValue(initialGain);
+    sampleRate_ = sampleRate;
+    setFadeTime(fadeTimeMs);
+    floatRamp_.assign(static_cast<size_t>(juce::jmax(1, maxBlockSize)), 0.0f);
+    doubleRamp_.assign(floatRamp_.size(), 0.0);
+
+    current_ = target_ = initialGain;
+    step_ = 0.0f;
+    countdown_ = 0;
+}
+
+void CrossFader::setFadeTime(int fadeTimeMs)
+{
+    fadeSamples_ = static_cast<int>(std::floor(sampleRate_ * fadeTimeMs * 0.001));
+}
+
+void CrossFader::setShape(Shape shape)
+{
+    switch (shape)
+    {
+        case Shape::linear:      curve_ = nullptr; break;
+        case Shape::equalPower:  curve_ = &FadeCurves::equalPower; break;
+        case Shape::exponential: curve_ = &FadeCurves::exponential; break;
+        case Shape::sCurve:      curve_ = &FadeCurves::sCurve; break;
+    }
 }
 
 void CrossFader::mute()
 {
-    fader_.setTargetValue(0.0f);
+    setTarget(0.0f);
 }
 
 void CrossFader::unmute()
 {
-    fader_.setTargetValue(1.0f);
+    setTarget(1.0f);
+}
+
+void CrossFader::advance(int numSamples)
+{
+    if (countdown_ == 0)
+        return;
+
+    countdown_ = juce::jmax(0, countdown_ - numSamples);
+    current_ = (countdown_ == 0) ? target_ : rampStart_ + step_ * static_cast<float>(rampLength_ - countdown_);
 }
 
-float CrossFader::getNextGain()
+float CrossFader::shapeGain(float position) const
 {
-    return fader_.getNextValue();
+    if (curve_ == nullptr || position <= 0.0f || position >= 1.0f)
+        return position;
+
+    const float x = position * FadeCurves::kTableSize;
+    const int index = static_cast<int>(x);
+    const auto* table = curve_->data() + index;
+    return table[0] + (x - static_cast<float>(index)) * (table[1] - table[0]);
+}
+
+void CrossFader::setTarget(float target)
+{
+    if (target == target_)
+        return;
+
+    target_ = target;
+
+    if (fadeSamples_ <= 0)
+    {
+        current_ = target_;
+        countdown_ = 0;
+        return;
+    }
+
+    countdown_ = rampLength_ = fadeSamples_;
+    rampStart_ = current_;
+    step_ = (target_ - current_) / static_cast<float>(countdown_);
+}
+
+template <typename SampleType>
+void CrossFader::process(SampleType* const* channels, int numChannels, int startSample, int numSamples)
+{
+    // Settled at unity: leave the buffer alone
+    if (countdown_ == 0 && current_ == 1.0f)
+        return;
+
+    switch (numChannels)
+    {
+        case 1:  processChannels<SampleType, 1>(channels, 1, startSample, numSamples); break;
+        case 2:  processChannels<SampleType, 2>(channels, 2, startSample, numSamples); break;
+        default: processChannels<SampleType, 0>(channels, numChannels, startSample, numSamples); break;
+    }
+}
+
+template void CrossFader::process<float>(float* const*, int, int, int);
+template void CrossFader::process<double>(double* const*, int, int, int);
+
+template <typename SampleType, int NumChannels>
+void CrossFader::processChannels(SampleType* const* channels, int numChannels, int startSample, int numSamples)
+{
+    // A non-zero NumChannels fixes the channel loops at compile time
+    const int channelCount = NumChannels > 0 ? NumChannels : numChannels;
+
+    // Ramp: build the gain curve once, then one multiply pass per channel.
+    // Blocks larger than the prepared size are walked in ramp-sized chunks.
+    // Gains are computed from the position in the fade rather than
+    // accumulated, so the output doesn't depend on how the block is split.
+    while (numSamples > 0 && countdown_ > 0)
+    {
+        auto& rampBuffer = getRamp<SampleType>();
+        const int n = juce::jmin(numSamples, countdown_, static_cast<int>(rampBuffer.size()));
+        const int position = rampLength_ - countdown_;
+        auto* ramp = rampBuffer.data();
+
+        const auto start = static_cast<SampleType>(rampStart_);
+        const auto step = static_cast<SampleType>(step_);
+        for (int i = 0; i < n; ++i)
+            ramp[i] = start + step * static_cast<SampleType>(position + i + 1);
+
+        countdown_ -= n;
+        current_ = (countdown_ == 0) ? target_ : static_cast<float>(ramp[n - 1]);
+
+        // Map positions to gains through the shape table
+        if (curve_ != nullptr)
+        {
+            const auto* table = curve_->data();
+            for (int i = 0; i < n; ++i)
+            {
+                const auto x = juce::jlimit(SampleType(0), SampleType(1), ramp[i]) * FadeCurves::kTableSize;
+                const int index = juce::jmin(static_cast<int>(x), FadeCurves::kTableSize - 1);
+                ramp[i] = table[index] + (x - static_cast<SampleType>(index)) * (table[index + 1] - table[index]);
+            }
+        }
+
+        // Land exactly on the target (0 and 1 are fixed points of every shape)
+        if (countdown_ == 0)
+            ramp[n - 1] = static_cast<SampleType>(target_);
+
+        for (int ch = 0; ch < channelCount; ++ch)
+            juce::FloatVectorOperations::multiply(channels[ch] + startSample, ramp, n);
+
+        startSample += n;
+        numSamples -= n;
+    }
+
+    if (numSamples <= 0 || current_ == 1.0f)
+        return;
+
+    if (current_ == 0.0f)
+        for (int ch = 0; ch < channelCount; ++ch)
+            juce::FloatVectorOperations::clear(channels[ch] + startSample, numSamples);
+    else
+        for (int ch = 0; ch < channelCount; ++ch)
+            juce::FloatVectorOperations::multiply(channels[ch] + startSample, static_cast<SampleType>(shapeGain(current_)), numSamples);
 }
@@ -0,0 +1,75 @@
+#include "DiagnosticsView.h"
+
+DiagnosticsView::DiagnosticsView(PluginProcessor& processor)
+    : processor_(processor)
+{
+    exportButton_.onClick = [this] { exportMetrics(); };
+    addAndMakeVisible(exportButton_);
+}
+
+void DiagnosticsView::paint(juce::Graphics& g)
+{
+    auto bounds = getLocalBounds().toFloat().reduced(2.0f);
+    g.setColour(juce::Colours::black);
+    g.fillRoundedRectangle(bounds, 6.0f);
+
+    auto area = getLocalBounds().reduced(8);
+    area.removeFromBottom(exportButton_.getHeight() + 4);
+    constexpr int rowHeight = 12;
+
+    g.setColour(juce::Colours::white);
+    g.setFont(11.0f);
+
+    metrics_.visit([&](const juce::String& name, const juce::String& value) {
+        // Empty timing buckets would crowd out the counters
+        if (name.startsWith("block_time_") && ! name.startsWith("block_time_max") && value == "0")
+            return;
+        if (area.getHeight() < rowHeight)
+            return;
+
+        auto row = area.removeFromTop(rowHeight);
+        g.drawText(name, row, juce::Justification::centredLeft);
+        g.drawText(value, row, juce::Justification::centredRight);
+    });
+}
+
+void DiagnosticsView::resized()
+{
+    exportButton_.setBounds(getLocalBounds().reduced(8).removeFromBottom(24));
+}
+
+void DiagnosticsView::visibilityChanged()
+{
+    if (isVisible())
+    {
+        timerCallback();
+        startTimerHz(4);
+    }
+    else
+    {
+        stopTimer();
+    }
+}
+
+void DiagnosticsView::timerCallback()
+{
+    metrics_ = processor_.getMetrics();
+    repaint();
+}
+
+void DiagnosticsView::exportMetrics()
+{
+    fileChooser_ = std::make_unique<juce::FileChooser>("Export metrics",
+                                                       juce::File::getSpecialLocation(juce::File::userDocumentsDirectory)
+                                                           .getChildFile("Semaforte metrics.csv"),
+                                                       "*.csv");
+
+    constexpr auto flags = juce::FileBrowserComponent::saveMode | juce::FileBrowserComponent::canSelectFiles
+                         | juce::FileBrowserComponent::warnAboutOverwriting;
+
+    fileChooser_->launchAsync(flags, [this](const juce::FileChooser& chooser) {
+        const auto file = chooser.getResult();
+        if (file != juce::File())
+            file.replaceWithText(processor_.getMetrics().toCsv());
+    });
+}
@@ -0,0 +1,111 @@
+#include "EditorResources.h"
+#include "BinaryData.h"
+#include <algorithm>
+
+EditorResources::EditorResources()
+    : background_(juce::Drawable::createFromImageData(BinaryData::background_svg, BinaryData::background_svgSize))
+{
+    if (background_)
+        titlePath_ = dynamic_cast<juce::DrawableShape*>(findChildWithIdRecursively(*background_, "text1"));
+}
+
+juce::Component* EditorResources::findChildWithIdRecursively(juce::Component& parent, juce::StringRef id)
+{
+    for (auto* child : parent.getChildren())
+    {
+        if (child->getComponentID() == id)
+            return child;
+        if (auto* found = findChildWithIdRecursively(*child, id))
+            return found;
+    }
+    return nullptr;
+}
+
+juce::Rectangle<int> EditorResources::getOpaqueBounds(const juce::Image& image)
+{
+    const juce::Image::BitmapData pixels(image, juce::Image::BitmapData::readOnly);
+    int left = image.getWidth(), top = image.getHeight(), right = 0, bottom = 0;
+
+    for (int y = 0; y < image.getHeight(); ++y)
+        for (int x = 0; x < image.getWidth(); ++x)
+            if (pixels.getPixelColour(x, y).getAlpha() != 0)
+            {
+                left = juce::jmin(left, x);
+                top = juce::jmin(top, y);
+                right = juce::jmax(right, x + 1);
+                bottom = juce::jmax(bottom, y + 1);
+            }
+
+    return right > left ? juce::Rectangle<int>(left, top, right - left, bottom - top) : juce::Rectangle<int>();
+}
+
+const EditorResources::Images& EditorResources::getImages(int width, int height, float scale)
+{
+    for (auto it = cache_.begin(); it != cache_.end(); ++it)
+        if (it->width == width && it->height == height && it->scale == scale)
+        {
+            std::rotate(it, it + 1, cache_.end());
+            return cache_.back();
+        }
+
+    if (cache_.size() == kMaxCachedSizes)
+        cache_.erase(cache_.begin());
+
+    cache_.push_back(render(width, height, scale));
+    return cache_.back();
+}
+
+EditorResources::Images EditorResources::render(int width, int height, float scale)
+{
+    Images images;
+    images.width = width;
+    images.height = height;
+    images.scale = scale;
+
+    if (! background_)
+        return images;
+
+    const int pixelWidth = juce::jmax(1, juce::roundToInt(static_cast<float>(width) * scale));
+    const int pixelHeight = juce::jmax(1, juce::roundToInt(static_cast<float>(height) * scale));
+    const juce::Rectangle<float> area(0.0f, 0.0f, static_cast<float>(pixelWidth), static_cast<float>(pixelHeight));
+
+    images.background = juce::Image(juce::Image::ARGB, pixelWidth, pixelHeight, true);
+
+    if (titlePath_)
+        titlePath_->setVisible(false);
+
+    {
+        juce::Graphics g(images.background);
+        background_->drawWithin(g, area, juce::RectanglePlacement::stretchToFit, 1.0f);
+    }
+
+    if (! titlePath_)
+        return images;
+
+    // Render the title on its own by hiding everything off its branch of
+    // the tree, so it keeps every transform of the groups above it
+    titlePath_->setVisible(true);
+    titlePath_->setFill(juce::Colours::white);
+
+    juce::Array<juce::Component*> hidden;
+    for (juce::Component* node = titlePath_; node != background_.get(); node = node->getParentComponent())
+        for (auto* sibling : node->getParentComponent()->getChildren())
+            if (sibling != node && sibling->isVisible())
+            {
+                sibling->setVisible(false);
+                hidden.add(sibling);
+            }
+
+    images.titleMask = juce::Image(juce::Image::SingleChannel, pixelWidth, pixelHeight, true);
+    {
+        juce::Graphics g(images.titleMask);
+        background_->drawWithin(g, area, juce::RectanglePlacement::stretchToFit, 1.0f);
+    }
+
+    for (auto* component : hidden)
+        component->setVisible(true);
+
+    images.titleArea = getOpaqueBounds(images.titleMask).toFloat().transformedBy(juce::AffineTransform::scale(1.0f / scale))
+                                                        .getSmallestIntegerContainer().expanded(1);
+    return images;
+}
@@ -0,0 +1,66 @@
+#include "LinkRegistry.h"
+
+bool LinkRegistry::Link::claim(juce::uint64 stamp)
+{
+    auto claimed = claimed_.load(std::memory_order_acquire);
+    return claimed != stamp && claimed_.compare_exchange_strong(claimed, stamp, std::memory_order_acq_rel);
+}
+
+juce::uint64 LinkRegistry::Link::publish(juce::uint64 stamp, const Decision* decisions, int count)
+{
+    count = juce::jmin(count, kMaxDecisions);
+
+    // Counted first, so a follower that sees the number and not the block
+    // yet tries again instead of skipping it
+    const auto number = numPublished_.fetch_add(1, std::memory_order_acq_rel);
+    auto& block = blocks_[static_cast<size_t>(number % kNumBlocks)];
+
+    const auto sequence = block.sequence.load(std::memory_order_relaxed);
+    block.sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    for (int i = 0; i < count; ++i)
+        block.decisions[static_cast<size_t>(i)].store(pack(decisions[i]), std::memory_order_relaxed);
+    block.count.store(count, std::memory_order_relaxed);
+    block.stamp.store(stamp, std::memory_order_relaxed);
+    block.number.store(number + 1, std::memory_order_relaxed);
+
+    block.sequence.store(sequence + 2, std::memory_order_release);
+    return number + 1;
+}
+
+int LinkRegistry::Link::read(juce::uint64 n, juce::uint64& stamp, Decision* decisions, int maxDecisions) const
+{
+    const auto& block = blocks_[static_cast<size_t>(n % kNumBlocks)];
+
+    const auto before = block.sequence.load(std::memory_order_acquire);
+    if ((before & 1) != 0 || block.number.load(std::memory_order_relaxed) != n + 1)
+        return -1;
+
+    const int count = block.count.load(std::memory_order_relaxed);
+    for (int i = 0; i < juce::jmin(count, maxDecisions); ++i)
+        decisions[i] = unpack(block.decisions[static_cast<size_t>(i)].load(std::memory_order_relaxed));
+    stamp = block.stamp.load(std::memory_order_relaxed);
+
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return block.sequence.load(std::memory_order_relaxed) == before ? count : -1;
+}
+
+uint32_t LinkRegistry::Link::pack(const Decision& decision)
+{
+    // Position in the low 24 bits, then the group, or the program with
+    // bit 6 set, and the muted flag
+    const auto target = decision.program != kNoProgram ? 0x40 | (decision.program & (kMaxPrograms - 1))
+                                                       : decision.group & 0x3F;
+    return (static_cast<uint32_t>(juce::jlimit(0, 0xFFFFFF, decision.samplePosition)))
+         | (static_cast<uint32_t>(target) << 24)
+         | (decision.muted ? 0x80000000u : 0u);
+}
+
+LinkRegistry::Decision LinkRegistry::Link::unpack(uint32_t packed)
+{
+    const int target = static_cast<int>((packed >> 24) & 0x7F);
+    const bool isProgram = (target & 0x40) != 0;
+    return { static_cast<int>(packed & 0xFFFFFF), isProgram ? 0 : target, (packed & 0x80000000u) != 0,
+             isProgram ? target & 0x3F : kNoProgram };
+}
@@ -0,0 +1,41 @@
+#include "Metrics.h"
+
+void Metrics::addBlockTime(double micros)
+{
+    ++blockTimes[static_cast<size_t>(getTimingBucket(micros))];
+    ++blocks;
+    maxBlockMicros = juce::jmax(maxBlockMicros, micros);
+}
+
+void Metrics::addSilenceLatency(int samples)
+{
+    ++silenceLatencyCount;
+    lastSilenceLatency = samples;
+    maxSilenceLatency = juce::jmax(maxSilenceLatency, samples);
+}
+
+int Metrics::getTimingBucket(double micros)
+{
+    int bucket = 0;
+    for (double limit = 1.0; micros >= limit && bucket < kNumTimingBuckets - 1; limit *= 2.0)
+        ++bucket;
+    return bucket;
+}
+
+juce::String Metrics::getTimingBucketName(int bucket)
+{
+    if (bucket == 0)
+        return "under_1us";
+    if (bucket == kNumTimingBuckets - 1)
+        return "over_" + juce::String(1 << (bucket - 1)) + "us";
+    return juce::String(1 << (bucket - 1)) + "_" + juce::String(1 << bucket) + "us";
+}
+
+juce::String Metrics::toCsv() const
+{
+    juce::String csv = "metric,value\n";
+    visit([&csv](const juce::String& name, const juce::String& value) {
+        csv << name << "," << value << "\n";
+    });
+    return csv;
+}
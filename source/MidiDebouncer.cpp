@@ -1,36 +1,76 @@
 #include "MidiDebouncer.h"
-#include <optional>
 
-void MidiDebouncer::prepare(double sampleRate, int samplesPerBlock, int ignoreTimeMs)
+MidiDebouncer::MidiDebouncer()
 {
-    samplesPerBlock_ = samplesPerBlock;
-    ignoreSamples_ = static_cast<juce::int64>(sampleRate * ignoreTimeMs * 0.001);
-    samplesSinceLast_ = ignoreSamples_;
+    for (auto& window : windowMs_)
+        window.store(kDefaultWindowMs, std::memory_order_relaxed);
 }
 
-std::optional<juce::MidiMessage> MidiDebouncer::processBlock(const juce::MidiBuffer& midi)
+void MidiDebouncer::prepare(double sampleRate)
 {
+    sampleRate_ = sampleRate;
+    reset();
+}
+
+void MidiDebouncer::reset()
+{
+    slots_.fill({});
+}
+
+void MidiDebouncer::setWindow(int action, int windowMs)
+{
+    if (juce::isPositiveAndBelow(action, kNumActions))
+        windowMs_[static_cast<size_t>(action)].store(juce::jmax(0, windowMs), std::memory_order_relaxed);
+}
+
+int MidiDebouncer::getWindow(int action) const
+{
+    return juce::isPositiveAndBelow(action, kNumActions) ? windowMs_[static_cast<size_t>(action)].load(std::memory_order_relaxed)
+                                                         : 0;
+}
+
+MidiDebouncer::Events MidiDebouncer::processBlock(const juce::MidiBuffer& midi)
+{
+    int numEvents = 0;
+    int numSeen = 0;
+    int numDropped = 0;
+
     for (const auto metadata : midi)
     {
-        auto msg = metadata.getMessage();
+        ++numSeen;
 
-        // Skip Note Off and Note On with velocity 0
-        if (msg.isNoteOff() || (msg.isNoteOn() && msg.getVelocity() == 0))
+        // Skip Note Off and Note On with velocity 0, read straight from the
+        // raw bytes so no MidiMessage has to be constructed
+        const auto status = metadata.data[0] & 0xF0;
+        if (status == 0x80 || (status == 0x90 && metadata.numBytes > 2 && metadata.data[2] == 0))
             continue;
 
-        int samplePos = metadata.samplePosition;
+        if (numEvents == kMaxEventsPerBlock)
+            ++numDropped;
+        else
+            events_[static_cast<size_t>(numEvents++)] = metadata;
+    }
 
-        // accumulate sample counter across blocks
-        juce::int64 samplesElapsed = samplesSinceLast_ + samplePos;
+    return { events_.data(), numEvents, numSeen, numDropped };
+}
 
-        if (samplesElapsed >= ignoreSamples_)
-        {
-            samplesSinceLast_ = 0; // reset after accepting message
-            return msg;
-        }
-    }
+size_t MidiDebouncer::slotIndex(int32_t trigger, int action)
+{
+    const auto hash = (static_cast<uint32_t>(trigger) * 2u + static_cast<uint32_t>(action)) * 2654435761u;
+    return static_cast<size_t>(hash >> 26);
+}
+
+bool MidiDebouncer::accept(int32_t trigger, int action, juce::int64 time)
+{
+    if (! juce::isPositiveAndBelow(action, kNumActions))
+        return false;
+
+    const auto windowSamples = static_cast<juce::int64>(sampleRate_ * getWindow(action) * 0.001);
+    auto& slot = slots_[slotIndex(trigger, action)];
+
+    if (slot.trigger == trigger && slot.action == action && time - slot.time < windowSamples)
+        return false;
 
-    // nothing allowed this block
-    samplesSinceLast_ += midi.getNumEvents() > 0 ? midi.getLastEventTime() : samplesPerBlock_;
-    return std::nullopt;
+    slot = { trigger, action, time };
+    return true;
 }
@@ -0,0 +1,86 @@
+#include "MidiDecoder.h"
+
+void MidiDecoder::reset()
+{
+    channels_.fill({});
+}
+
+MidiDecoder::Keys MidiDecoder::decode(const juce::MidiMessageMetadata& msg)
+{
+    Keys keys;
+    const int status = msg.data[0];
+    const int data1 = msg.numBytes > 1 ? msg.data[1] : 0;
+    keys.keys[0] = (status << 8) | data1;
+    keys.values[0] = msg.numBytes > 2 ? msg.data[2] : 0;
+    keys.count = 1;
+
+    if ((status & 0xF0) != 0xB0 || msg.numBytes < 3)
+        return keys;
+
+    const int channel = status & 0x0F;
+    const int value = msg.data[2];
+    auto& state = channels_[static_cast<size_t>(channel)];
+
+    const auto select = [&state](Kind kind, bool msb, int number) {
+        // Switching between NRPN and RPN starts from the null parameter
+        if (kind != state.parameterKind)
+            state.parameter = 0x3FFF;
+        state.hasData = false;
+        state.parameterKind = kind;
+        state.parameter = msb ? (number << 7) | (state.parameter & 0x7F)
+                              : (state.parameter & 0x3F80) | number;
+        return true;
+    };
+
+    switch (data1)
+    {
+        case 99:  keys.partial = select(Kind::nrpn, true, value); break;
+        case 98:  keys.partial = select(Kind::nrpn, false, value); break;
+        case 101: keys.partial = select(Kind::rpn, true, value); break;
+        case 100: keys.partial = select(Kind::rpn, false, value); break;
+
+        case 6:
+            // Data entry MSB completes an (N)RPN, unless the null parameter is selected
+            keys.partial = state.parameter != 0x3FFF;
+            if (keys.partial)
+            {
+                state.hasData = true;
+                state.dataMsb = static_cast<uint8_t>(value);
+                keys.keys[1] = makeKey(state.parameterKind, channel, state.parameter);
+                keys.values[1] = value << 7;
+                keys.count = 2;
+            }
+            break;
+
+        case 38:
+            // The LSB is optional, so the MSB has acted already; this only
+            // refines its value
+            keys.partial = state.parameter != 0x3FFF;
+            if (keys.partial && state.hasData)
+            {
+                keys.refinement = true;
+                keys.keys[1] = makeKey(state.parameterKind, channel, state.parameter);
+                keys.values[1] = (state.dataMsb << 7) | value;
+                keys.count = 2;
+            }
+            break;
+
+        default:
+            if (data1 < 32)
+            {
+                state.pendingMsb |= 1u << data1;
+                state.msbValues[static_cast<size_t>(data1)] = static_cast<uint8_t>(value);
+            }
+            else if (data1 < 64 && (state.pendingMsb & (1u << (data1 - 32))) != 0)
+            {
+                state.pendingMsb &= ~(1u << (data1 - 32));
+                keys.partial = true;
+                keys.keys[1] = makeKey(Kind::cc14, channel, data1 - 32);
+                keys.values[1] = (state.msbValues[static_cast<size_t>(data1 - 32)] << 7) | value;
+                keys.count = 2;
+            }
+            break;
+    }
+
+    return keys;
+}
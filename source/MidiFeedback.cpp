@@ -0,0 +1,106 @@
+#include "MidiFeedback.h"
+
+uint32_t MidiFeedback::pack(const juce::MidiMessage& message)
+{
+    // Short channel messages only; a default MidiMessage is an empty sysex
+    const int size = message.getRawDataSize();
+    const auto* data = message.getRawData();
+    if (size < 1 || size > 3 || data[0] < 0x80 || data[0] >= 0xF0)
+        return 0;
+
+    uint32_t packed = static_cast<uint32_t>(size) << 24;
+    for (int i = 0; i < size; ++i)
+        packed |= static_cast<uint32_t>(data[i]) << (8 * i);
+    return packed;
+}
+
+void MidiFeedback::setMessage(int group, State state, int slot, uint32_t packed)
+{
+    messages_[static_cast<size_t>(group)][static_cast<size_t>(state)][static_cast<size_t>(slot)].store(packed, std::memory_order_relaxed);
+    configVersion_.fetch_add(1, std::memory_order_release);
+}
+
+uint32_t MidiFeedback::getMessage(int group, State state, int slot) const
+{
+    return messages_[static_cast<size_t>(group)][static_cast<size_t>(state)][static_cast<size_t>(slot)].load(std::memory_order_relaxed);
+}
+
+void MidiFeedback::setMessages(int group, const Messages& messages)
+{
+    auto& stored = messages_[static_cast<size_t>(group)];
+    for (size_t state = 0; state < stored.size(); ++state)
+        for (size_t slot = 0; slot < stored[state].size(); ++slot)
+            stored[state][slot].store(messages[state][slot], std::memory_order_relaxed);
+
+    configVersion_.fetch_add(1, std::memory_order_release);
+}
+
+MidiFeedback::Messages MidiFeedback::getMessages(int group) const
+{
+    Messages messages;
+    const auto& stored = messages_[static_cast<size_t>(group)];
+    for (size_t state = 0; state < stored.size(); ++state)
+        for (size_t slot = 0; slot < stored[state].size(); ++slot)
+            messages[state][slot] = stored[state][slot].load(std::memory_order_relaxed);
+
+    return messages;
+}
+
+bool MidiFeedback::hasMessages(int group) const
+{
+    for (const auto& state : messages_[static_cast<size_t>(group)])
+        for (const auto& message : state)
+            if (message.load(std::memory_order_relaxed) != 0)
+                return true;
+
+    return false;
+}
+
+void MidiFeedback::reset()
+{
+    sent_.fill(-1);
+    numPending_ = 0;
+}
+
+void MidiFeedback::update(int group, State state, int samplePosition)
+{
+    // A new configuration is sent out as soon as it's seen
+    const auto version = configVersion_.load(std::memory_order_acquire);
+    if (version != sentVersion_)
+    {
+        sentVersion_ = version;
+        sent_.fill(-1);
+    }
+
+    auto& sent = sent_[static_cast<size_t>(group)];
+    if (sent == static_cast<int>(state))
+        return;
+
+    const auto& messages = messages_[static_cast<size_t>(group)][static_cast<size_t>(state)];
+
+    // Without room for all of them, the state is left unsent and tried again
+    // on the next update
+    int count = 0;
+    for (const auto& message : messages)
+        count += message.load(std::memory_order_relaxed) != 0 ? 1 : 0;
+    if (numPending_ + count > kPoolSize)
+        return;
+
+    sent = static_cast<int>(state);
+    for (const auto& message : messages)
+        if (const auto packed = message.load(std::memory_order_relaxed); packed != 0)
+            pool_[static_cast<size_t>(numPending_++)] = { samplePosition, packed };
+}
+
+void MidiFeedback::flush(juce::MidiBuffer& midi)
+{
+    for (int i = 0; i < numPending_; ++i)
+    {
+        const auto& pending = pool_[static_cast<size_t>(i)];
+        const uint8_t data[] = { static_cast<uint8_t>(pending.packed), static_cast<uint8_t>(pending.packed >> 8),
+                                 static_cast<uint8_t>(pending.packed >> 16) };
+        midi.addEvent(data, static_cast<int>(pending.packed >> 24), pending.samplePosition);
+    }
+
+    numPending_ = 0;
+}
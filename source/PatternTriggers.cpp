@@ -0,0 +1,212 @@
+#include "PatternTriggers.h"
+#include <algorithm>
+#include <atomic>
+
+namespace PatternTriggers
+{
+namespace
+{
+    // Lowest bit of every 4-bit pattern nibble
+    constexpr uint64_t kFirstSteps = 0x1111111111111111ull;
+    constexpr uint64_t kNibble = 0xF;
+
+    /** One bit (the nibble's lowest) per pattern with any step set */
+    uint64_t patternsOf(uint64_t steps)
+    {
+        return (steps | (steps >> 1) | (steps >> 2) | (steps >> 3)) & kFirstSteps;
+    }
+
+    int lowestBit(uint64_t bits)
+    {
+        return juce::countNumberOfBits((bits & (~bits + 1)) - 1);
+    }
+
+    int getStepBit(int pattern, int step)
+    {
+        return (pattern % 16) * 4 + step;
+    }
+}
+
+//==============================================================================
+bool Pattern::hasSameSteps(const Pattern& other) const
+{
+    if (numSteps != other.numSteps || ordered != other.ordered)
+        return false;
+
+    for (int step = 0; step < numSteps; ++step)
+        if (keys[static_cast<size_t>(step)] != other.keys[static_cast<size_t>(step)])
+            return false;
+
+    return true;
+}
+
+//==============================================================================
+bool Set::add(const Pattern& pattern)
+{
+    if (pattern.numSteps < 1 || pattern.numSteps > kMaxSteps)
+        return false;
+
+    auto* const end = patterns_.data() + numPatterns_;
+    auto* existing = std::find_if(patterns_.data(), end, [&pattern](const Pattern& p) { return p.hasSameSteps(pattern); });
+
+    if (existing == end)
+    {
+        if (numPatterns_ == kMaxPatterns)
+            return false;
+        ++numPatterns_;
+    }
+
+    *existing = pattern;
+    compile();
+    return true;
+}
+
+void Set::clear(int action)
+{
+    auto* const end = patterns_.data() + numPatterns_;
+    numPatterns_ = static_cast<int>(std::remove_if(patterns_.data(), end, [action](const Pattern& p) { return p.action == action; })
+                                    - patterns_.data());
+    compile();
+}
+
+void Set::clearAll()
+{
+    numPatterns_ = 0;
+    compile();
+}
+
+int Set::hash(int32_t key)
+{
+    // Fibonacci hashing, top 8 bits
+    return static_cast<int>((static_cast<uint32_t>(key) * 2654435761u) >> 24);
+}
+
+const std::array<uint64_t, 2>* Set::lookup(int32_t key) const
+{
+    // Terminates: the index is never more than half full
+    for (int i = hash(key);; i = (i + 1) & (kIndexSize - 1))
+    {
+        const auto& slot = index_[static_cast<size_t>(i)];
+        if (slot.key == key)
+            return &slot.steps;
+        if (slot.key == kEmptyKey)
+            return nullptr;
+    }
+}
+
+void Set::compile()
+{
+    index_.fill({});
+    chordSteps_ = {};
+    sequenceSteps_ = {};
+
+    for (int p = 0; p < numPatterns_; ++p)
+    {
+        const auto& pattern = patterns_[static_cast<size_t>(p)];
+        const auto word = static_cast<size_t>(p / 16);
+
+        for (int step = 0; step < pattern.numSteps; ++step)
+        {
+            const auto bit = uint64_t { 1 } << getStepBit(p, step);
+            (pattern.ordered ? sequenceSteps_ : chordSteps_)[word] |= bit;
+
+            const auto key = pattern.keys[static_cast<size_t>(step)];
+            int i = hash(key);
+            while (index_[static_cast<size_t>(i)].key != kEmptyKey && index_[static_cast<size_t>(i)].key != key)
+                i = (i + 1) & (kIndexSize - 1);
+
+            index_[static_cast<size_t>(i)].key = key;
+            index_[static_cast<size_t>(i)].steps[word] |= bit;
+        }
+    }
+
+    // Unique across all sets, so a matcher notices a table restored from state
+    static std::atomic<uint32_t> generations { 0 };
+    generation_ = ++generations;
+}
+
+//==============================================================================
+void Matcher::prepare(double sampleRate)
+{
+    sampleRate_ = sampleRate;
+    reset();
+}
+
+void Matcher::reset()
+{
+    received_ = {};
+    completed_ = {};
+}
+
+void Matcher::finish(bool fired)
+{
+    if (fired)
+        for (size_t word = 0; word < received_.size(); ++word)
+            received_[word] &= ~completed_[word];
+
+    completed_ = {};
+}
+
+int Matcher::process(const Set& set, int32_t key, juce::int64 time)
+{
+    if (set.getGeneration() != generation_)
+    {
+        reset();
+        generation_ = set.getGeneration();
+    }
+
+    const auto* waiting = set.lookup(key);
+    if (waiting == nullptr)
+        return kNoAction;
+
+    int result = kNoAction;
+
+    for (size_t word = 0; word < received_.size(); ++word)
+    {
+        const auto steps = (*waiting)[word];
+        if (steps == 0)
+            continue;
+
+        auto& received = received_[word];
+        const auto chords = set.getChordSteps()[word];
+        const auto sequences = set.getSequenceSteps()[word];
+
+        // Progress of the key's patterns is only looked at now, so that is
+        // when a partial match that ran out of time is dropped
+        for (auto patterns = patternsOf(steps); patterns != 0; patterns &= patterns - 1)
+        {
+            const int shift = lowestBit(patterns);
+            const int p = static_cast<int>(word) * 16 + shift / 4;
+            const auto windowSamples = static_cast<juce::int64>(sampleRate_ * set[p].windowMs * 0.001);
+            if ((received & (kNibble << shift)) != 0 && time - started_[static_cast<size_t>(p)] > windowSamples)
+                received &= ~(kNibble << shift);
+        }
+
+        // Any missing chord step is accepted, but only the next sequence step
+        const auto next = ((received << 1) | kFirstSteps) & sequences;
+        const auto accepted = steps & ~received & (chords | next);
+
+        // A pattern left complete by an event that didn't fire completes
+        // again on its last key
+        for (auto patterns = patternsOf(steps); patterns != 0; patterns &= patterns - 1)
+        {
+            const int shift = lowestBit(patterns);
+            const int p = static_cast<int>(word) * 16 + shift / 4;
+            const auto nibble = kNibble << shift;
+
+            if ((received & nibble) == 0 && (accepted & nibble) != 0)
+                started_[static_cast<size_t>(p)] = time;
+
+            received |= accepted & nibble;
+            if ((received & nibble) != ((chords | sequences) & nibble))
+                continue;
+
+            completed_[word] |= nibble;
+            const int action = set[p].action;
+            result = (result == kNoAction) ? action : juce::jmin(result, action);
+        }
+    }
+
+    return result;
+}
+}
@@ -8,42 +8,26 @@
 
 #include "PluginProcessor.h"
 #include "PluginEditor.h"
-#include "BinaryData.h"
 
 //==============================================================================
 PluginEditor::PluginEditor(PluginProcessor& p)
     : AudioProcessorEditor(&p), audioProcessor_(p),
-      background_(juce::Drawable::createFromImageData(BinaryData::background_svg, BinaryData::background_svgSize))
+      diagnostics_(p)
 {
-    if (background_)
-    {
-        std::function<juce::Component*(juce::Component*, juce::StringRef)> findRecursive =
-            [&](juce::Component* parent, juce::StringRef id) -> juce::Component* {
-            for (auto* c : parent->getChildren())
-            {
-                if (c->getComponentID() == id)
-                    return c;
-                if (auto* found = findRecursive(c, id))
-                    return found;
-            }
-            return nullptr;
-        };
-        titlePath_ = dynamic_cast<juce::DrawableShape*>(findRecursive(background_.get(), "text1"));
-    }
     // Stop button (red)
     stopButton_.setActiveColour(juce::Colours::red);
     stopButton_.onClick = [this] {
-        if (audioProcessor_.getMidiLearnTarget() >= 0)
-            audioProcessor_.setMidiLearnTarget(-1);
-        audioProcessor_.setMuted(true);
+        if (audioProcessor_.getMidiLearnTarget(group_) >= 0)
+            audioProcessor_.setMidiLearnTarget(group_, -1);
+        audioProcessor_.setMuted(group_, true);
     };
     stopButton_.onLongPress = [this] {
-        if (audioProcessor_.getMidiLearnTarget() == 0)
-            audioProcessor_.setMidiLearnTarget(-1);
+        if (audioProcessor_.getMidiLearnTarget(group_) == 0)
+            audioProcessor_.setMidiLearnTarget(group_, -1);
         else
         {
-            audioProcessor_.clearTriggers(0);
-            audioProcessor_.setMidiLearnTarget(0);
+            audioProcessor_.clearTriggers(group_, 0);
+            audioProcessor_.setMidiLearnTarget(group_, 0);
         }
         updateButtons();
     };
@@ -52,36 +36,121 @@ PluginEditor::PluginEditor(PluginProcessor& p)
     // Go button (green)
     goButton_.setActiveColour(juce::Colours::green);
     goButton_.onClick = [this] {
-        if (audioProcessor_.getMidiLearnTarget() >= 0)
-            audioProcessor_.setMidiLearnTarget(-1);
-        audioProcessor_.setMuted(false);
+        if (audioProcessor_.getMidiLearnTarget(group_) >= 0)
+            audioProcessor_.setMidiLearnTarget(group_, -1);
+        audioProcessor_.setMuted(group_, false);
     };
     goButton_.onLongPress = [this] {
-        if (audioProcessor_.getMidiLearnTarget() == 1)
-            audioProcessor_.setMidiLearnTarget(-1);
+        if (audioProcessor_.getMidiLearnTarget(group_) == 1)
+            audioProcessor_.setMidiLearnTarget(group_, -1);
         else
         {
-            audioProcessor_.clearTriggers(1);
-            audioProcessor_.setMidiLearnTarget(1);
+            audioProcessor_.clearTriggers(group_, 1);
+            audioProcessor_.setMidiLearnTarget(group_, 1);
         }
         updateButtons();
     };
     addAndMakeVisible(goButton_);
 
-    // Register callback for processor -> GUI updates
-    audioProcessor_.onStateChanged = [this] {
+    // Mute group selector
+    for (int group = 0; group < PluginProcessor::kNumGroups; ++group)
+        groupSelector_.addItem("Group " + juce::String(group + 1), group + 1);
+    groupSelector_.setSelectedId(group_ + 1, juce::dontSendNotification);
+    groupSelector_.onChange = [this] {
+        group_ = groupSelector_.getSelectedId() - 1;
         updateButtons();
     };
+    addAndMakeVisible(groupSelector_);
+
+    // Fade shape selector, ids follow CrossFader::Shape
+    shapeSelector_.addItem("Linear", 1);
+    shapeSelector_.addItem("Equal power", 2);
+    shapeSelector_.addItem("Exponential", 3);
+    shapeSelector_.addItem("S-curve", 4);
+    shapeSelector_.onChange = [this] {
+        audioProcessor_.setFadeShape(static_cast<CrossFader::Shape>(shapeSelector_.getSelectedId() - 1));
+    };
+    addAndMakeVisible(shapeSelector_);
+
+    // Trigger program shown, edited and played; names are refreshed with
+    // the rest of the state
+    for (int program = 0; program < PluginProcessor::kNumPrograms; ++program)
+        programSelector_.addItem(audioProcessor_.getProgramName(program), program + 1);
+    programSelector_.onChange = [this] {
+        audioProcessor_.setCurrentProgram(programSelector_.getSelectedId() - 1);
+        audioProcessor_.updateHostDisplay(juce::AudioProcessor::ChangeDetails().withProgramChanged(true));
+    };
+    addAndMakeVisible(programSelector_);
+
+    // Program Change channel, ids are the channel + 1
+    programChangeSelector_.addItem("PC off", PluginProcessor::kProgramChangeOff + 1);
+    for (int channel = 1; channel <= 16; ++channel)
+        programChangeSelector_.addItem("PC ch " + juce::String(channel), channel + 1);
+    programChangeSelector_.addItem("PC any", PluginProcessor::kProgramChangeAny + 1);
+    programChangeSelector_.onChange = [this] {
+        audioProcessor_.setProgramChangeChannel(programChangeSelector_.getSelectedId() - 1);
+    };
+    addAndMakeVisible(programChangeSelector_);
+
+    // What long-press learning records, ids follow PluginProcessor::LearnMode
+    learnModeSelector_.addItem("Learn single messages", 1);
+    learnModeSelector_.addItem("Learn chords", 2);
+    learnModeSelector_.addItem("Learn sequences", 3);
+    learnModeSelector_.addItem("Learn thresholds", 4);
+    learnModeSelector_.onChange = [this] {
+        audioProcessor_.setLearnMode(static_cast<PluginProcessor::LearnMode>(learnModeSelector_.getSelectedId() - 1));
+    };
+    addAndMakeVisible(learnModeSelector_);
+
+    // Lookahead: fades end on the trigger, at the cost of latency
+    lookaheadButton_.onClick = [this] {
+        audioProcessor_.setLookahead(lookaheadButton_.getToggleState());
+    };
+    addAndMakeVisible(lookaheadButton_);
+
+    // Echo the group's state to its trigger notes/controllers
+    feedbackButton_.onClick = [this] {
+        audioProcessor_.setFeedbackFromTriggers(group_, feedbackButton_.getToggleState());
+    };
+    addAndMakeVisible(feedbackButton_);
 
-    // Initial state
+    // Link group, id 1 is unlinked
+    linkSelector_.addItem("No link", 1);
+    for (int link = 1; link <= LinkRegistry::kNumLinks; ++link)
+        linkSelector_.addItem("Link " + juce::String(link), link + 1);
+    linkSelector_.onChange = [this] {
+        audioProcessor_.setLinkGroup(linkSelector_.getSelectedId() - 1);
+    };
+    addAndMakeVisible(linkSelector_);
+
+    // Optional metrics overlay
+    diagnosticsButton_.setClickingTogglesState(true);
+    diagnosticsButton_.onClick = [this] {
+        diagnostics_.setVisible(diagnosticsButton_.getToggleState());
+    };
+    addAndMakeVisible(diagnosticsButton_);
+    addChildComponent(diagnostics_);
+
+    // Initial state, later changes are picked up by pollState()
+    shownVersion_ = audioProcessor_.getStateVersion();
     updateButtons();
 
-    setSize(200, 400);
+    setSize(200, 528);
 }
 
 PluginEditor::~PluginEditor()
 {
-    audioProcessor_.onStateChanged = nullptr;
+}
+
+void PluginEditor::pollState()
+{
+    // Read the version before the state so a change in between isn't missed
+    const auto version = audioProcessor_.getStateVersion();
+    if (version == shownVersion_)
+        return;
+
+    shownVersion_ = version;
+    updateButtons();
 }
 
 juce::String PluginEditor::formatTrigger(int32_t trigger)
@@ -89,6 +158,16 @@ juce::String PluginEditor::formatTrigger(int32_t trigger)
     if (trigger < 0)
         return {};
 
+    const auto kind = MidiDecoder::getKind(trigger);
+    if (kind != MidiDecoder::Kind::raw)
+    {
+        const auto name = kind == MidiDecoder::Kind::nrpn ? "NRPN "
+                        : kind == MidiDecoder::Kind::rpn  ? "RPN "
+                                                          : "CC14 ";
+        return "Ch " + juce::String(MidiDecoder::getChannel(trigger) + 1) + " " + name
+             + juce::String(MidiDecoder::getNumber(trigger));
+    }
+
     int status = (trigger >> 8) & 0xFF;
     int data1 = trigger & 0xFF;
     int channel = (status & 0x0F) + 1;
@@ -107,52 +186,113 @@ juce::String PluginEditor::formatTrigger(int32_t trigger)
     return "Ch " + juce::String(channel) + " " + typeName;
 }
 
-juce::String PluginEditor::formatTriggers(std::function<int32_t(int)> getter, int count)
+juce::String PluginEditor::formatPattern(const PatternTriggers::Pattern& pattern)
+{
+    juce::StringArray steps;
+    for (int step = 0; step < pattern.numSteps; ++step)
+        steps.add(formatTrigger(pattern.keys[static_cast<size_t>(step)]));
+
+    // Chord steps sound together, sequence steps one after the other
+    return steps.joinIntoString(pattern.ordered ? " > " : " + ");
+}
+
+juce::String PluginEditor::formatValueTrigger(const ValueTriggers::Trigger& trigger)
+{
+    const auto key = formatTrigger(trigger.key);
+
+    switch (trigger.mode)
+    {
+        case ValueTriggers::Mode::rising:  return key + " rises to " + juce::String(trigger.threshold);
+        case ValueTriggers::Mode::falling: return key + " falls to " + juce::String(trigger.threshold);
+        case ValueTriggers::Mode::range:   break;
+    }
+
+    return key + " " + juce::String(trigger.low) + "-" + juce::String(trigger.high);
+}
+
+juce::String PluginEditor::formatTriggers(const juce::Array<int32_t>& triggers,
+                                          const juce::Array<PatternTriggers::Pattern>& patterns,
+                                          const juce::Array<ValueTriggers::Trigger>& values)
 {
     juce::StringArray lines;
-    for (int i = 0; i < count; ++i)
+    for (auto trigger : triggers)
     {
-        auto text = formatTrigger(getter(i));
+        auto text = formatTrigger(trigger);
         if (text.isNotEmpty())
             lines.add(text);
     }
+    for (const auto& pattern : patterns)
+        lines.add(formatPattern(pattern));
+    for (const auto& value : values)
+        lines.add(formatValueTrigger(value));
     return lines.isEmpty() ? "--" : lines.joinIntoString("\n");
 }
 
 void PluginEditor::updateButtons()
 {
-    bool muted = audioProcessor_.isMuted();
-    int learning = audioProcessor_.getMidiLearnTarget();
+    bool muted = audioProcessor_.isMuted(group_);
+    int learning = audioProcessor_.getMidiLearnTarget(group_);
 
     stopButton_.setSelected(muted);
     stopButton_.setLearning(learning == 0);
-    stopButton_.setText(formatTriggers(
-        [this](int i) { return audioProcessor_.getStopTrigger(i); },
-        PluginProcessor::kMaxTriggers));
+    stopButton_.setText(formatTriggers(audioProcessor_.getTriggers(group_, 0), audioProcessor_.getPatterns(group_, 0),
+                                       audioProcessor_.getValueTriggers(group_, 0)));
 
     goButton_.setSelected(!muted);
     goButton_.setLearning(learning == 1);
-    goButton_.setText(formatTriggers(
-        [this](int i) { return audioProcessor_.getGoTrigger(i); },
-        PluginProcessor::kMaxTriggers));
+    goButton_.setText(formatTriggers(audioProcessor_.getTriggers(group_, 1), audioProcessor_.getPatterns(group_, 1),
+                                     audioProcessor_.getValueTriggers(group_, 1)));
+
+    shapeSelector_.setSelectedId(static_cast<int>(audioProcessor_.getFadeShape()) + 1, juce::dontSendNotification);
+    learnModeSelector_.setSelectedId(static_cast<int>(audioProcessor_.getLearnMode()) + 1, juce::dontSendNotification);
+    lookaheadButton_.setToggleState(audioProcessor_.isLookaheadEnabled(), juce::dontSendNotification);
+    feedbackButton_.setToggleState(audioProcessor_.isFeedbackFromTriggers(group_) || audioProcessor_.hasFeedback(group_), juce::dontSendNotification);
+    linkSelector_.setSelectedId(audioProcessor_.getLinkGroup() + 1, juce::dontSendNotification);
+
+    for (int program = 0; program < PluginProcessor::kNumPrograms; ++program)
+        programSelector_.changeItemText(program + 1, audioProcessor_.getProgramName(program));
+    programSelector_.setSelectedId(audioProcessor_.getCurrentProgram() + 1, juce::dontSendNotification);
+    programChangeSelector_.setSelectedId(audioProcessor_.getProgramChangeChannel() + 1, juce::dontSendNotification);
 
-    if (titlePath_)
+    auto colour = learning >= 0 ? juce::Colours::yellow
+                : muted         ? juce::Colours::red
+                                : juce::Colours::green;
+
+    // Only the title changes colour, the cached background stays as it is
+    if (resources_->hasTitle() && colour != titleColour_)
     {
-        auto colour = learning >= 0 ? juce::Colours::yellow
-                    : muted         ? juce::Colours::red
-                                    : juce::Colours::green;
-        titlePath_->setFill(colour);
-        repaint();
+        titleColour_ = colour;
+        if (images_.titleArea.isEmpty())
+            repaint();
+        else
+            repaint(images_.titleArea);
     }
 }
 
 //==============================================================================
 void PluginEditor::paint(juce::Graphics& g)
 {
-    if (background_)
-        background_->drawWithin(g, getLocalBounds().toFloat(), juce::RectanglePlacement::stretchToFit, 1.0f);
-    else
+    if (! resources_->hasBackground())
+    {
         g.fillAll(getLookAndFeel().findColour(juce::ResizableWindow::backgroundColourId));
+        return;
+    }
+
+    // Vector rendering only happens the first time any editor is painted at
+    // a size and display scale; state changes repaint the title area with
+    // two image blits
+    const float scale = g.getInternalContext().getPhysicalPixelScaleFactor();
+    if (scale != images_.scale || getWidth() != images_.width || getHeight() != images_.height)
+        images_ = resources_->getImages(getWidth(), getHeight(), scale);
+
+    const auto bounds = getLocalBounds().toFloat();
+    g.drawImage(images_.background, bounds, juce::RectanglePlacement::stretchToFit);
+
+    if (images_.titleMask.isValid())
+    {
+        g.setColour(titleColour_);
+        g.drawImage(images_.titleMask, bounds, juce::RectanglePlacement::stretchToFit, true);
+    }
 }
 
 void PluginEditor::resized()
@@ -161,7 +301,32 @@ void PluginEditor::resized()
     constexpr int buttonHeight = 160;
     constexpr int gap = 16;
 
+    diagnostics_.setBounds(area.withHeight(buttonHeight * 2 + gap));
+
     stopButton_.setBounds(area.removeFromTop(buttonHeight));
     area.removeFromTop(gap);
     goButton_.setBounds(area.removeFromTop(buttonHeight));
+    area.removeFromTop(gap / 2);
+
+    auto selectors = area.removeFromTop(24);
+    groupSelector_.setBounds(selectors.removeFromLeft(selectors.getWidth() / 2).reduced(2, 0));
+    shapeSelector_.setBounds(selectors.reduced(2, 0));
+    area.removeFromTop(gap / 2);
+
+    auto programs = area.removeFromTop(24);
+    programSelector_.setBounds(programs.removeFromLeft(programs.getWidth() / 2).reduced(2, 0));
+    programChangeSelector_.setBounds(programs.reduced(2, 0));
+    area.removeFromTop(gap / 2);
+
+    learnModeSelector_.setBounds(area.removeFromTop(24).reduced(2, 0));
+    area.removeFromTop(gap / 2);
+
+    auto links = area.removeFromTop(24);
+    feedbackButton_.setBounds(links.removeFromLeft(links.getWidth() / 2).reduced(2, 0));
+    linkSelector_.setBounds(links.reduced(2, 0));
+    area.removeFromTop(gap / 2);
+
+    auto options = area.removeFromTop(24);
+    lookaheadButton_.setBounds(options.removeFromLeft(options.getWidth() / 2).reduced(2, 0));
+    diagnosticsButton_.setBounds(options.reduced(2, 0));
 }
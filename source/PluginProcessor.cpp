@@ -8,23 +8,75 @@
 
 #include "PluginProcessor.h"
 #include "PluginEditor.h"
+#include <algorithm>
+#include <limits>
 
 //==============================================================================
 PluginProcessor::PluginProcessor()
 #ifndef JucePlugin_PreferredChannelConfigurations
-     : AudioProcessor(
-         BusesProperties()
-             .withInput("Input", juce::AudioChannelSet::stereo(), true)
-             .withOutput("Output", juce::AudioChannelSet::stereo(), true)
-       )
+     : AudioProcessor(createBusesProperties()),
+       parameters(*this, nullptr, "Parameters", createParameterLayout())
+#else
+     : parameters(*this, nullptr, "Parameters", createParameterLayout())
 #endif
 {
+    for (int group = 0; group < kNumGroups; ++group)
+        muteValues_[static_cast<size_t>(group)] = parameters.getRawParameterValue(getMuteParameterId(group));
+    fadeTimeValue_ = parameters.getRawParameterValue("fadeTime");
+    bypassValue_ = parameters.getRawParameterValue("bypass");
+
+    // The first program is where triggers are learnt by default; the empty
+    // table is built here rather than on the audio thread
+    getMaps(0);
+    getEmptyTable();
+
+    // Reports mutes from MIDI and links, so it runs whenever there is a
+    // message loop, not just while learning
+    startTimerHz(30);
 }
 
 PluginProcessor::~PluginProcessor()
 {
 }
 
+PluginProcessor::BusesProperties PluginProcessor::createBusesProperties()
+{
+    auto buses = BusesProperties()
+                     .withInput("Input", juce::AudioChannelSet::stereo(), true)
+                     .withOutput("Output", juce::AudioChannelSet::stereo(), true);
+
+    // One optional aux bus pair per additional mute group
+    for (int group = 1; group < kNumGroups; ++group)
+    {
+        const auto name = "Group " + juce::String(group + 1);
+        buses = buses.withInput(name, juce::AudioChannelSet::stereo(), false)
+                     .withOutput(name, juce::AudioChannelSet::stereo(), false);
+    }
+
+    return buses;
+}
+
+juce::AudioProcessorValueTreeState::ParameterLayout PluginProcessor::createParameterLayout()
+{
+    juce::AudioProcessorValueTreeState::ParameterLayout layout;
+
+    for (int group = 0; group < kNumGroups; ++group)
+        layout.add(std::make_unique<juce::AudioParameterBool>(juce::ParameterID { getMuteParameterId(group), 1 },
+                                                              "Group " + juce::String(group + 1) + " Mute", false));
+
+    layout.add(std::make_unique<juce::AudioParameterInt>(juce::ParameterID { "fadeTime", 1 }, "Fade Time",
+                                                         1, kMaxFadeTimeMs, kDefaultFadeTimeMs,
+                                                         juce::AudioParameterIntAttributes().withLabel("ms")));
+
+    layout.add(std::make_unique<juce::AudioParameterBool>(juce::ParameterID { "bypass", 1 }, "Bypass", false));
+    return layout;
+}
+
+juce::String PluginProcessor::getMuteParameterId(int group)
+{
+    return "mute" + juce::String(group + 1);
+}
+
 //==============================================================================
 const juce::String PluginProcessor::getName() const
 {
@@ -38,7 +90,7 @@ bool PluginProcessor::acceptsMidi() const
 
 bool PluginProcessor::producesMidi() const
 {
-    return false;
+    return true;
 }
 
 bool PluginProcessor::isMidiEffect() const
@@ -53,32 +105,139 @@ double PluginProcessor::getTailLengthSeconds() const
 
 int PluginProcessor::getNumPrograms()
 {
-    return 1;
+    return kNumPrograms;
 }
 
 int PluginProcessor::getCurrentProgram()
 {
-    return 0;
+    return currentProgram_.load(std::memory_order_acquire);
 }
 
 void PluginProcessor::setCurrentProgram(int index)
 {
+    // Hosts call this from the message or the audio thread
+    if (! juce::isPositiveAndBelow(index, kNumPrograms))
+        return;
+
+    currentProgram_.store(index, std::memory_order_release);
+    bumpStateVersion();
 }
 
 const juce::String PluginProcessor::getProgramName(int index)
 {
-    return {};
+    if (! juce::isPositiveAndBelow(index, kNumPrograms))
+        return {};
+
+    const juce::ScopedLock lock(triggerLock_);
+    const auto& name = programNames_[static_cast<size_t>(index)];
+    return name.isNotEmpty() ? name : "Program " + juce::String(index + 1);
 }
 
 void PluginProcessor::changeProgramName(int index, const juce::String& newName)
 {
+    if (! juce::isPositiveAndBelow(index, kNumPrograms))
+        return;
+
+    {
+        const juce::ScopedLock lock(triggerLock_);
+        programNames_[static_cast<size_t>(index)] = newName;
+    }
+    bumpStateVersion();
+}
+
+int PluginProcessor::getProgramChangeChannel() const
+{
+    return programChangeChannel_.load(std::memory_order_relaxed);
+}
+
+void PluginProcessor::setProgramChangeChannel(int channel)
+{
+    programChangeChannel_.store(juce::jlimit(kProgramChangeOff, kProgramChangeAny, channel), std::memory_order_relaxed);
+    bumpStateVersion();
+}
+
+const TriggerMap::Table& PluginProcessor::getEmptyTable()
+{
+    // Read-only, so every instance and thread can share it
+    static const TriggerMap::Table empty;
+    return empty;
+}
+
+std::array<TriggerMap, PluginProcessor::kNumGroups>& PluginProcessor::getMaps(int program)
+{
+    auto& storage = programStorage_[static_cast<size_t>(program)];
+    if (storage == nullptr)
+    {
+        storage = std::make_unique<Program>();
+        programs_[static_cast<size_t>(program)].store(storage.get(), std::memory_order_release);
+    }
+
+    return storage->maps;
+}
+
+const TriggerMap::Table& PluginProcessor::getCurrentTable(int group) const
+{
+    const auto& storage = programStorage_[static_cast<size_t>(currentProgram_.load(std::memory_order_acquire))];
+    return storage != nullptr ? storage->maps[static_cast<size_t>(group)].getTable() : getEmptyTable();
 }
 
 //==============================================================================
 void PluginProcessor::prepareToPlay(double sampleRate, int samplesPerBlock)
 {
-    midiDebouncer_.prepare(sampleRate, samplesPerBlock, 10);
-    crossFader_.prepare(sampleRate, 50, isMuted() ? 0.0f : 1.0f);
+    midiDebouncer_.prepare(sampleRate);
+    midiDecoder_.reset();
+    feedback_.reset();
+
+    fadeTimeMs_ = preparedFadeTimeMs_ = juce::roundToInt(fadeTimeValue_->load(std::memory_order_relaxed));
+
+    for (int index = 0; index < kNumGroups; ++index)
+    {
+        // Faders start from the requested state, so pending mute requests
+        // are already applied; they are dropped before it is read
+        auto& group = groups_[static_cast<size_t>(index)];
+        groupStatus_[static_cast<size_t>(index)].muteRequest.store(kNoRequest, std::memory_order_relaxed);
+        group.learnTarget = getMidiLearnTarget(index);
+        group.crossFader.prepare(sampleRate, fadeTimeMs_, samplesPerBlock, isMuted(index) ? 0.0f : 1.0f);
+        group.crossFader.setShape(getFadeShape());
+        group.patterns.prepare(sampleRate);
+        group.values.reset();
+        group.muteParameter = muteValues_[static_cast<size_t>(index)]->load(std::memory_order_relaxed) >= 0.5f;
+
+        // Locate the group's bus in the processBlock buffer
+        const auto* bus = getBus(false, index);
+        group.numChannels = (bus != nullptr && bus->isEnabled()) ? bus->getNumberOfChannels() : 0;
+        group.firstChannel = group.numChannels > 0 ? getChannelIndexInProcessBlockBuffer(false, index, 0) : 0;
+    }
+
+    // With the audio delayed by one sample less than the fade, the ramp's
+    // final sample (at the target gain) lines up with the trigger's sample
+    const int lookaheadSamples = juce::jmax(0, groups_[0].crossFader.getFadeSamples() - 1);
+    lookaheadSamples_.store(lookaheadSamples, std::memory_order_relaxed);
+
+    const int numChannels = juce::jmax(getTotalNumInputChannels(), getTotalNumOutputChannels());
+    if (isUsingDoublePrecision())
+    {
+        doubleDelay_.prepare(numChannels, lookaheadSamples);
+        doubleDry_.setSize(numChannels, samplesPerBlock);
+        floatDelay_.release();
+        floatDry_.setSize(0, 0);
+    }
+    else
+    {
+        floatDelay_.prepare(numChannels, lookaheadSamples);
+        floatDry_.setSize(numChannels, samplesPerBlock);
+        doubleDelay_.release();
+        doubleDry_.setSize(0, 0);
+    }
+
+    bypassed_ = bypassValue_->load(std::memory_order_relaxed) >= 0.5f;
+    wetFader_.prepare(sampleRate, fadeTimeMs_, samplesPerBlock, bypassed_ ? 0.0f : 1.0f);
+    dryFader_.prepare(sampleRate, fadeTimeMs_, samplesPerBlock, bypassed_ ? 1.0f : 0.0f);
+
+    lookahead_ = isLookaheadEnabled();
+    delayedFader_.prepare(sampleRate, fadeTimeMs_, samplesPerBlock, lookahead_ ? 1.0f : 0.0f);
+    directFader_.prepare(sampleRate, fadeTimeMs_, samplesPerBlock, lookahead_ ? 0.0f : 1.0f);
+    setLatencySamples(lookahead_ ? lookaheadSamples : 0);
 }
 
 void PluginProcessor::releaseResources()
@@ -88,232 +247,1505 @@ void PluginProcessor::releaseResources()
 #ifndef JucePlugin_PreferredChannelConfigurations
 bool PluginProcessor::isBusesLayoutSupported(const BusesLayout& layouts) const
 {
-    if (layouts.getMainOutputChannelSet() != juce::AudioChannelSet::mono()
-     && layouts.getMainOutputChannelSet() != juce::AudioChannelSet::stereo())
+    // Any discrete or immersive layout is gated as a whole by its group's fader
+    if (layouts.getMainOutputChannelSet().isDisabled())
         return false;
 
-   #if ! JucePlugin_IsSynth
-    if (layouts.getMainOutputChannelSet() != layouts.getMainInputChannelSet())
-        return false;
-   #endif
+    for (int bus = 0; bus < layouts.outputBuses.size(); ++bus)
+    {
+        const auto output = layouts.getChannelSet(false, bus);
+        if (output.size() > kMaxChannels)
+            return false;
+
+       #if ! JucePlugin_IsSynth
+        if (bus >= layouts.inputBuses.size() || output != layouts.getChannelSet(true, bus))
+            return false;
+       #endif
+    }
 
     return true;
 }
 #endif
 
+bool PluginProcessor::supportsDoublePrecisionProcessing() const
+{
+    return true;
+}
+
 void PluginProcessor::processBlock(juce::AudioBuffer<float>& buffer, juce::MidiBuffer& midiMessages)
 {
-    juce::ScopedNoDenormals noDenormals;
+    processAudio(buffer, midiMessages, false);
+}
 
-    handleMidi(midiMessages);
-    processBuffer(buffer);
+void PluginProcessor::processBlock(juce::AudioBuffer<double>& buffer, juce::MidiBuffer& midiMessages)
+{
+    processAudio(buffer, midiMessages, false);
 }
 
-int32_t PluginProcessor::packMidiForMatch(const juce::MidiMessage& msg)
+void PluginProcessor::processBlockBypassed(juce::AudioBuffer<float>& buffer, juce::MidiBuffer& midiMessages)
 {
-    const auto* data = msg.getRawData();
-    return (static_cast<int32_t>(data[0]) << 8) | static_cast<int32_t>(data[1]);
+    processAudio(buffer, midiMessages, true);
 }
 
-bool PluginProcessor::midiMatches(const juce::MidiMessage& incoming, int32_t stored)
+void PluginProcessor::processBlockBypassed(juce::AudioBuffer<double>& buffer, juce::MidiBuffer& midiMessages)
 {
-    if (stored == kUnassignedTrigger)
-        return false;
+    processAudio(buffer, midiMessages, true);
+}
 
-    return packMidiForMatch(incoming) == stored;
+juce::AudioProcessorParameter* PluginProcessor::getBypassParameter() const
+{
+    return parameters.getParameter("bypass");
 }
 
-void PluginProcessor::handleMidi(const juce::MidiBuffer& midi)
+template <typename SampleType>
+void PluginProcessor::processAudio(juce::AudioBuffer<SampleType>& buffer, juce::MidiBuffer& midiMessages, bool hostBypassed)
 {
-    if (auto msg = midiDebouncer_.processBlock(midi))
+    juce::ScopedNoDenormals noDenormals;
+    const auto startTicks = juce::Time::getHighResolutionTicks();
+
+    applyRequests();
+    updateParameters();
+    updateFeedback(0);
+    setBypassed(hostBypassed || bypassValue_->load(std::memory_order_relaxed) >= 0.5f);
+
+    const int numSamples = buffer.getNumSamples();
+    const int numChannels = buffer.getNumChannels();
+
+    auto& dry = getDryBuffer<SampleType>();
+    if (numSamples > dry.getNumSamples() || numChannels > dry.getNumChannels())
     {
-        int target = midiLearnTarget_.load(std::memory_order_relaxed);
-        if (target == 0 || target == 1)
+        // Larger than prepared: finish the crossfades rather than allocate
+        for (auto* fader : { &wetFader_, &dryFader_, &delayedFader_, &directFader_ })
+            fader->advance(std::numeric_limits<int>::max());
+    }
+
+    // Bypassed audio is delayed too, so the reported latency holds
+    processLookahead(buffer, dry);
+
+    const bool crossfading = wetFader_.isSmoothing();
+    const bool renderAudio = crossfading || ! bypassed_;
+
+    if (crossfading)
+        for (int ch = 0; ch < numChannels; ++ch)
+            dry.copyFrom(ch, 0, buffer, ch, 0, numSamples);
+
+    int renderedUpTo = 0;
+
+    // The program is pinned for as long as its tables are read; one without
+    // tables reads as empty
+    std::array<const TriggerMap::Table*, kNumGroups> triggers;
+
+    const auto pin = [&triggers](Program* pinned) {
+        for (size_t group = 0; group < triggers.size(); ++group)
+            triggers[group] = pinned != nullptr ? &pinned->maps[group].beginRead() : &getEmptyTable();
+    };
+
+    const auto unpin = [](Program* pinned) {
+        if (pinned != nullptr)
+            for (auto& map : pinned->maps)
+                map.endRead();
+    };
+
+    const auto loadProgram = [this] {
+        return programs_[static_cast<size_t>(currentProgram_.load(std::memory_order_acquire))].load(std::memory_order_acquire);
+    };
+
+    auto* program = loadProgram();
+    pin(program);
+
+    // Switched by an event, a link decision or the host: later events in
+    // the block match against the new program
+    const auto followProgram = [&] {
+        if (auto* current = loadProgram(); current != program)
         {
-            // Learning mode: fill next empty slot
-            auto& triggers = (target == 0) ? stopTriggers_ : goTriggers_;
-            auto& oppositeTriggers = (target == 0) ? goTriggers_ : stopTriggers_;
-            auto packed = packMidiForMatch(*msg);
+            unpin(program);
+            pin(current);
+            program = current;
+        }
+    };
 
-            // Remove from opposite set if already assigned there
-            for (int i = 0; i < kMaxTriggers; ++i)
-            {
-                if (oppositeTriggers[i].load(std::memory_order_relaxed) == packed)
-                    oppositeTriggers[i].store(kUnassignedTrigger, std::memory_order_relaxed);
-            }
+    // A linked follower applies the leader's decisions instead of its own.
+    // Learning needs the MIDI, so a learning instance decodes and acts.
+    bool learning = false;
+    for (const auto& group : groups_)
+        learning = learning || group.learnTarget >= 0;
+
+    auto* link = updateLink();
+    const auto stamp = link != nullptr ? getBlockStamp() : 0;
+    const bool leading = stamp != 0 && link->claim(stamp);
+    const bool following = stamp != 0 && ! leading && ! learning;
+
+    // Taking the lead from another instance: what this one matched before
+    // following is stale
+    if (leading && following_)
+        resetMidiState();
+
+    if (following)
+    {
+        ++metrics_.linkedBlocks;
+        const int numLinked = followLink(*link, stamp);
+
+        for (int i = 0; i < numLinked; ++i)
+        {
+            const auto& decision = linkDecisions_[static_cast<size_t>(i)];
+            const int eventPos = juce::jlimit(renderedUpTo, numSamples, decision.samplePosition);
+            if (renderAudio)
+                processBuffer(buffer, renderedUpTo, eventPos - renderedUpTo);
+            if (decision.program != LinkRegistry::kNoProgram)
+                setCurrentProgram(decision.program);
+            else if (juce::isPositiveAndBelow(decision.group, kNumGroups))
+                applyDecision(decision.group, decision.muted);
+            updateFeedback(eventPos);
+            renderedUpTo = eventPos;
+        }
+
+        // The instance's own MIDI isn't decoded, Program Change included
+        followProgram();
+    }
+    else
+    {
+        // MIDI is decoded once and dispatched to every group. Render up to
+        // each event so a fade it starts begins on its sample.
+        const auto events = midiDebouncer_.processBlock(midiMessages);
+        metrics_.midiSeen += static_cast<juce::uint64>(events.seen);
+        metrics_.midiDropped += static_cast<juce::uint64>(events.dropped);
+        numLinkDecisions_ = 0;
 
-            for (int i = 0; i < kMaxTriggers; ++i)
+        for (const auto& event : events)
+        {
+            const int eventPos = juce::jlimit(renderedUpTo, numSamples, event.samplePosition);
+            if (renderAudio)
+                processBuffer(buffer, renderedUpTo, eventPos - renderedUpTo);
+            handleMidi(event, triggers.data());
+            updateFeedback(eventPos);
+            renderedUpTo = eventPos;
+
+            // A Program Change being learnt as a trigger doesn't switch.
+            // Followers switch with the leader.
+            if (! learning && isProgramChange(event) && event.data[1] < kNumPrograms)
             {
-                if (triggers[i].load(std::memory_order_relaxed) == kUnassignedTrigger)
-                {
-                    triggers[i].store(packed, std::memory_order_relaxed);
-                    // Exit learn mode if that was the last slot
-                    if (i == kMaxTriggers - 1)
-                        midiLearnTarget_.store(-1, std::memory_order_relaxed);
-                    triggerAsyncUpdate();
-                    return;
-                }
+                setCurrentProgram(event.data[1]);
+                if (numLinkDecisions_ < LinkRegistry::kMaxDecisions)
+                    linkDecisions_[static_cast<size_t>(numLinkDecisions_++)] = { event.samplePosition, 0, false, event.data[1] };
             }
+
+            followProgram();
+        }
+
+        // Published even without decisions, so followers see the block.
+        // The leader has applied its own, so it skips it when it follows.
+        if (leading)
+            nextLinkBlock_ = link->publish(stamp, linkDecisions_.data(), numLinkDecisions_);
+    }
+
+    following_ = following;
+    leading_ = leading;
+    unpin(program);
+
+    // The events point into midiMessages, so feedback waits until here.
+    // Only feedback goes out: echoing the input would send a controller's
+    // own messages back to it.
+    midiMessages.clear();
+    feedback_.flush(midiMessages);
+
+    if (renderAudio)
+    {
+        processBuffer(buffer, renderedUpTo, numSamples - renderedUpTo);
+    }
+    else
+    {
+        // Fully bypassed: the input passes through untouched, faders only
+        // keep time so they are where they should be when bypass ends
+        for (auto& group : groups_)
+            group.crossFader.advance(numSamples);
+    }
+
+    if (crossfading)
+    {
+        auto* const* wetChannels = buffer.getArrayOfWritePointers();
+        auto* const* dryChannels = dry.getArrayOfWritePointers();
+
+        wetFader_.process(wetChannels, numChannels, 0, numSamples);
+        dryFader_.process(dryChannels, numChannels, 0, numSamples);
+
+        for (int ch = 0; ch < numChannels; ++ch)
+            juce::FloatVectorOperations::add(wetChannels[ch], dryChannels[ch], numSamples);
+    }
+
+    sampleClock_ += numSamples;
+    publishedClock_.store(sampleClock_, std::memory_order_relaxed);
+
+    metrics_.addBlockTime(static_cast<double>(juce::Time::getHighResolutionTicks() - startTicks) * microsPerTick_);
+    publishedMetrics_.publish(metrics_);
+}
+
+void PluginProcessor::applyRequests()
+{
+    for (int index = 0; index < kNumGroups; ++index)
+    {
+        auto& group = groups_[static_cast<size_t>(index)];
+        auto& status = groupStatus_[static_cast<size_t>(index)];
+        group.learnTarget = status.midiLearnTarget.load(std::memory_order_relaxed);
+
+        const int muteRequest = status.muteRequest.exchange(kNoRequest, std::memory_order_acquire);
+        if (muteRequest == 1)
+            group.crossFader.mute();
+        else if (muteRequest == 0)
+            group.crossFader.unmute();
+
+        // Only swaps a table pointer
+        group.crossFader.setShape(getFadeShape());
+    }
+
+    if (const bool lookahead = isLookaheadEnabled(); lookahead != lookahead_)
+    {
+        lookahead_ = lookahead;
+        if (lookahead)
+        {
+            // The ring was idle, so it holds stale audio
+            floatDelay_.reset();
+            doubleDelay_.reset();
+            delayedFader_.unmute();
+            directFader_.mute();
         }
         else
         {
-            // Normal mode: check stop triggers first (priority), then go
-            for (int i = 0; i < kMaxTriggers; ++i)
-            {
-                if (midiMatches(*msg, stopTriggers_[i].load(std::memory_order_relaxed)))
-                {
-                    setMuted(true);
-                    return;
-                }
-            }
-            for (int i = 0; i < kMaxTriggers; ++i)
-            {
-                if (midiMatches(*msg, goTriggers_[i].load(std::memory_order_relaxed)))
-                {
-                    setMuted(false);
-                    return;
-                }
-            }
+            delayedFader_.mute();
+            directFader_.unmute();
         }
     }
 }
 
-void PluginProcessor::processBuffer(juce::AudioBuffer<float>& buffer)
+void PluginProcessor::updateParameters()
 {
-    const int numChannels = buffer.getNumChannels();
-    const int numSamples = buffer.getNumSamples();
+    // JUCE hands parameters over without sub-block timestamps, so a change
+    // takes effect on the first sample of the block it arrives in
+    const int fadeTimeMs = lookahead_ ? preparedFadeTimeMs_
+                                      : juce::roundToInt(fadeTimeValue_->load(std::memory_order_relaxed));
+    if (fadeTimeMs != fadeTimeMs_)
+    {
+        fadeTimeMs_ = fadeTimeMs;
+        for (auto& group : groups_)
+            group.crossFader.setFadeTime(fadeTimeMs_);
+    }
 
-    for (int s = 0; s < numSamples; ++s)
+    for (int index = 0; index < kNumGroups; ++index)
     {
-        float gain = crossFader_.getNextGain();
-        for (int ch = 0; ch < numChannels; ++ch)
-            buffer.setSample(ch, s, buffer.getSample(ch, s) * gain);
+        auto& group = groups_[static_cast<size_t>(index)];
+        const bool muted = muteValues_[static_cast<size_t>(index)]->load(std::memory_order_relaxed) >= 0.5f;
+
+        // The timer copying a MIDI or link mute to the parameter comes back
+        // here; the state has moved on since, so that change is skipped
+        auto& status = groupStatus_[static_cast<size_t>(index)];
+        const int reported = status.muteReported.load(std::memory_order_relaxed) != kNoRequest
+                                 ? status.muteReported.exchange(kNoRequest, std::memory_order_acquire)
+                                 : kNoRequest;
+
+        if (muted != group.muteParameter)
+        {
+            group.muteParameter = muted;
+            if (reported != (muted ? 1 : 0))
+                applyMuted(index, muted);
+        }
     }
 }
 
-//==============================================================================
-bool PluginProcessor::hasEditor() const
+void PluginProcessor::setBypassed(bool bypassed)
 {
-    return true;
+    if (bypassed == bypassed_)
+        return;
+
+    bypassed_ = bypassed;
+    if (bypassed)
+    {
+        wetFader_.mute();
+        dryFader_.unmute();
+    }
+    else
+    {
+        wetFader_.unmute();
+        dryFader_.mute();
+    }
 }
 
-juce::AudioProcessorEditor* PluginProcessor::createEditor()
+void PluginProcessor::applyMuted(int group, bool muted)
 {
-    return new PluginEditor(*this);
+    groupStatus_[static_cast<size_t>(group)].muted.store(muted, std::memory_order_relaxed);
+
+    auto& crossFader = groups_[static_cast<size_t>(group)].crossFader;
+    if (muted)
+        crossFader.mute();
+    else
+        crossFader.unmute();
+    bumpStateVersion();
 }
 
-//==============================================================================
-void PluginProcessor::getStateInformation(juce::MemoryBlock& destData)
+void PluginProcessor::applyDecision(int group, bool muted)
 {
-    auto xml = std::make_unique<juce::XmlElement>("Semaforte");
-    xml->setAttribute("version", 1);
+    applyMuted(group, muted);
+    groupStatus_[static_cast<size_t>(group)].muteUnreported.store(true, std::memory_order_release);
+}
 
-    auto* stopXml = xml->createNewChildElement("stopTriggers");
-    for (int i = 0; i < kMaxTriggers; ++i)
+void PluginProcessor::updateFeedback(int samplePosition)
+{
+    for (int index = 0; index < kNumGroups; ++index)
     {
-        auto* trigger = stopXml->createNewChildElement("trigger");
-        trigger->addTextElement(juce::String(stopTriggers_[i].load(std::memory_order_relaxed)));
+        const auto& group = groups_[static_cast<size_t>(index)];
+        const auto state = group.learnTarget == 0                  ? MidiFeedback::State::learningStop
+                         : group.learnTarget == 1                  ? MidiFeedback::State::learningGo
+                         : group.crossFader.getTargetGain() == 0.0f ? MidiFeedback::State::muted
+                                                                    : MidiFeedback::State::unmuted;
+        feedback_.update(index, state, samplePosition);
     }
+}
 
-    auto* goXml = xml->createNewChildElement("goTriggers");
-    for (int i = 0; i < kMaxTriggers; ++i)
+LinkRegistry::Link* PluginProcessor::updateLink()
+{
+    const int link = linkGroup_.load(std::memory_order_relaxed);
+    if (link != activeLink_)
     {
-        auto* trigger = goXml->createNewChildElement("trigger");
-        trigger->addTextElement(juce::String(goTriggers_[i].load(std::memory_order_relaxed)));
+        activeLink_ = link;
+        following_ = leading_ = false;
     }
 
-    xml->setAttribute("muted", isMuted());
-
-    copyXmlToBinary(*xml, destData);
+    return activeLink_ > 0 ? &links_->getLink(activeLink_ - 1) : nullptr;
 }
 
-void PluginProcessor::setStateInformation(const void* data, int sizeInBytes)
+int PluginProcessor::followLink(LinkRegistry::Link& link, juce::uint64 stamp)
 {
-    auto xml = getXmlFromBinary(data, sizeInBytes);
+    const auto published = link.getNumPublished();
 
-    if (xml != nullptr && xml->hasTagName("Semaforte"))
+    // Joining: blocks from before this one are history. An instance that
+    // led the last block continues from its own.
+    const bool joining = ! following_ && ! leading_;
+
+    // Blocks that have left the ring are lost
+    constexpr auto ringSize = static_cast<juce::uint64>(LinkRegistry::kNumBlocks);
+    nextLinkBlock_ = joining ? published - juce::jmin(published, ringSize)
+                             : juce::jmax(nextLinkBlock_, published - juce::jmin(published, ringSize));
+
+    int count = 0;
+    for (; nextLinkBlock_ < published; ++nextLinkBlock_)
     {
-        if (auto* stopXml = xml->getChildByName("stopTriggers"))
-        {
-            int i = 0;
-            for (auto* trigger : stopXml->getChildIterator())
-            {
-                if (i >= kMaxTriggers)
-                    break;
-                stopTriggers_[i].store(trigger->getAllSubText().getIntValue(),
-                                       std::memory_order_relaxed);
-                ++i;
-            }
-        }
+        auto* const decisions = linkDecisions_.data() + count;
+        const int room = LinkRegistry::kMaxDecisions - count;
+        juce::uint64 blockStamp = 0;
+        const int numDecisions = link.read(nextLinkBlock_, blockStamp, decisions, room);
+
+        // Still being written, or no room left: taken next block
+        if (numDecisions < 0 || numDecisions > room)
+            break;
+
+        if (joining && blockStamp != stamp)
+            continue;
 
-        if (auto* goXml = xml->getChildByName("goTriggers"))
+        // Published after this instance ran that block: the decisions act
+        // on the first sample of this one
+        if (blockStamp != stamp)
         {
-            int i = 0;
-            for (auto* trigger : goXml->getChildIterator())
-            {
-                if (i >= kMaxTriggers)
-                    break;
-                goTriggers_[i].store(trigger->getAllSubText().getIntValue(),
-                                     std::memory_order_relaxed);
-                ++i;
-            }
+            for (int i = 0; i < numDecisions; ++i)
+                decisions[i].samplePosition = 0;
+            metrics_.lateLinkDecisions += static_cast<juce::uint64>(numDecisions);
         }
 
-        setMuted(xml->getBoolAttribute("muted", false));
+        count += numDecisions;
     }
+
+    return count;
 }
 
-//==============================================================================
-int32_t PluginProcessor::getStopTrigger(int slot) const
+juce::uint64 PluginProcessor::getBlockStamp() const
 {
-    if (slot < 0 || slot >= kMaxTriggers)
-        return kUnassignedTrigger;
-    return stopTriggers_[slot].load(std::memory_order_relaxed);
+    // Every plugin in the host sees the same block time; without one,
+    // linked instances can't tell whether they are in the same block
+    auto* playHead = getPlayHead();
+    if (playHead == nullptr)
+        return 0;
+
+    const auto position = playHead->getPosition();
+    if (! position)
+        return 0;
+
+    if (const auto hostTime = position->getHostTimeNs())
+        return *hostTime;
+
+    if (const auto time = position->getTimeInSamples(); time && position->getIsPlaying())
+        return static_cast<juce::uint64>(*time) | (juce::uint64 { 1 } << 63);
+
+    return 0;
 }
 
-int32_t PluginProcessor::getGoTrigger(int slot) const
+bool PluginProcessor::isProgramChange(const juce::MidiMessageMetadata& msg) const
 {
-    if (slot < 0 || slot >= kMaxTriggers)
-        return kUnassignedTrigger;
-    return goTriggers_[slot].load(std::memory_order_relaxed);
+    if (msg.numBytes < 2 || (msg.data[0] & 0xF0) != 0xC0)
+        return false;
+
+    const int channel = getProgramChangeChannel();
+    return channel == kProgramChangeAny || channel == (msg.data[0] & 0x0F) + 1;
 }
 
-void PluginProcessor::clearTriggers(int button)
+void PluginProcessor::resetMidiState()
 {
-    auto& triggers = (button == 0) ? stopTriggers_ : goTriggers_;
-    for (int i = 0; i < kMaxTriggers; ++i)
-        triggers[i].store(kUnassignedTrigger, std::memory_order_relaxed);
+    midiDecoder_.reset();
+    midiDebouncer_.reset();
+
+    for (auto& group : groups_)
+    {
+        group.patterns.reset();
+        group.values.reset();
+    }
 }
 
-bool PluginProcessor::isMuted() const
+void PluginProcessor::handleMidi(const juce::MidiMessageMetadata& msg, const TriggerMap::Table* const* triggers)
 {
-    return muted_.load(std::memory_order_relaxed);
+    const auto keys = midiDecoder_.decode(msg);
+    const auto time = sampleClock_ + msg.samplePosition;
+
+    // Every group is matched first, so the debouncer decides once per
+    // action however many groups share the trigger
+    std::array<int, kNumGroups> actions;
+    bool matched = false;
+
+    for (int index = 0; index < kNumGroups; ++index)
+    {
+        auto& group = groups_[static_cast<size_t>(index)];
+        auto& action = actions[static_cast<size_t>(index)];
+        action = TriggerMap::kNoAction;
+
+        if (group.learnTarget == 0 || group.learnTarget == 1)
+        {
+            // Learning mode: the message thread owns the map and groups the
+            // keys into triggers, so hand over every one of them
+            for (int i = keys.partial ? 1 : 0; i < keys.count; ++i)
+                if (! learntTriggers_.push({ index, group.learnTarget, keys.keys[static_cast<size_t>(i)],
+                                             keys.values[static_cast<size_t>(i)], time, keys.refinement && i == 1 }))
+                    ++metrics_.learnDropped;
+            continue;
+        }
+
+        // Normal mode: stop triggers have priority over go
+        const auto& table = *triggers[index];
+        action = table.lookup(keys.keys[0]);
+
+        // A refinement is the data entry the MSB already stepped patterns
+        // with; only its value is new
+        for (int i = 0; i < keys.count; ++i)
+        {
+            const auto key = keys.keys[static_cast<size_t>(i)];
+            const int patternAction = keys.refinement && i == 1 ? PatternTriggers::kNoAction
+                                                                : group.patterns.process(table.getPatterns(), key, time);
+            const int valueAction = group.values.process(table.getValueTriggers(), key, keys.values[static_cast<size_t>(i)]);
+
+            for (const int found : { patternAction, valueAction })
+                if (found != TriggerMap::kNoAction)
+                    action = (action == TriggerMap::kNoAction) ? found : juce::jmin(action, found);
+        }
+
+        matched = matched || action != TriggerMap::kNoAction;
+    }
+
+    if (! matched)
+        return;
+
+    // Debounced by the key that completed the match, composite if any.
+    // Matchers only drop a completed pattern's progress once the debouncer
+    // has let it fire.
+    const auto trigger = keys.keys[static_cast<size_t>(keys.count - 1)];
+    std::array<int, TriggerMap::kNumActions> accepted;  // -1 until decided
+    accepted.fill(-1);
+
+    for (int index = 0; index < kNumGroups; ++index)
+    {
+        const int action = actions[static_cast<size_t>(index)];
+        if (action == TriggerMap::kNoAction)
+            continue;
+
+        auto& decision = accepted[static_cast<size_t>(action)];
+        if (decision < 0)
+        {
+            decision = midiDebouncer_.accept(trigger, action, time) ? 1 : 0;
+            if (decision != 0)
+                ++metrics_.midiAccepted;
+            else
+                ++metrics_.midiRejected;
+        }
+
+        groups_[static_cast<size_t>(index)].patterns.finish(decision != 0);
+        if (decision == 0)
+            continue;
+
+        // A stop on a group that is already muted or fading out doesn't
+        // start a fade, so it has no latency to record
+        const auto& crossFader = groups_[static_cast<size_t>(index)].crossFader;
+        const bool stopsPlayback = action == 0 && crossFader.getTargetGain() != 0.0f;
+
+        ++metrics_.triggerMatches[static_cast<size_t>(action)];
+        applyDecision(index, action == 0);
+
+        if (numLinkDecisions_ < LinkRegistry::kMaxDecisions)
+            linkDecisions_[static_cast<size_t>(numLinkDecisions_++)] = { msg.samplePosition, index, action == 0 };
+
+        if (stopsPlayback)
+        {
+            // The ramp's last sample is the first silent one
+            const int delay = lookahead_ ? lookaheadSamples_.load(std::memory_order_relaxed) : 0;
+            metrics_.addSilenceLatency(juce::jmax(0, crossFader.getSamplesToTarget() - 1 - delay));
+        }
+    }
 }
 
-void PluginProcessor::setMuted(bool muted)
+template <typename SampleType>
+void PluginProcessor::processLookahead(juce::AudioBuffer<SampleType>& buffer, juce::AudioBuffer<SampleType>& scratch)
 {
-    muted_.store(muted, std::memory_order_relaxed);
-    if (muted)
-        crossFader_.mute();
+    const int numSamples = buffer.getNumSamples();
+    const int numChannels = buffer.getNumChannels();
+    auto* const* channels = buffer.getArrayOfWritePointers();
+    auto& delay = getDelay<SampleType>();
+
+    // Settled: without lookahead the ring sits idle
+    if (! delayedFader_.isSmoothing())
+    {
+        if (lookahead_)
+            delay.process(channels, numChannels, numSamples);
+        return;
+    }
+
+    // Switching: crossfade from one timeline to the other. The scratch
+    // buffer is free until the bypass crossfade copies the input into it.
+    for (int ch = 0; ch < numChannels; ++ch)
+        scratch.copyFrom(ch, 0, buffer, ch, 0, numSamples);
+
+    auto* const* direct = scratch.getArrayOfWritePointers();
+    if (lookahead_)
+    {
+        // Switching on: the ring was cleared, so the delayed signal is faded
+        // in as it enters and starts once the direct one has faded out
+        delayedFader_.process(channels, numChannels, 0, numSamples);
+        delay.process(channels, numChannels, numSamples);
+    }
     else
-        crossFader_.unmute();
-    triggerAsyncUpdate();
+    {
+        delay.process(channels, numChannels, numSamples);
+        delayedFader_.process(channels, numChannels, 0, numSamples);
+    }
+    directFader_.process(direct, numChannels, 0, numSamples);
+
+    for (int ch = 0; ch < numChannels; ++ch)
+        juce::FloatVectorOperations::add(channels[ch], direct[ch], numSamples);
+}
+
+template <typename SampleType>
+void PluginProcessor::processBuffer(juce::AudioBuffer<SampleType>& buffer, int startSample, int numSamples)
+{
+    if (numSamples <= 0)
+        return;
+
+    auto* const* channels = buffer.getArrayOfWritePointers();
+
+    for (auto& group : groups_)
+    {
+        const int numChannels = juce::jmin(group.numChannels, buffer.getNumChannels() - group.firstChannel);
+        if (numChannels > 0)
+            group.crossFader.process(channels + group.firstChannel, numChannels, startSample, numSamples);
+    }
+}
+
+//==============================================================================
+bool PluginProcessor::hasEditor() const
+{
+    return true;
 }
 
-int PluginProcessor::getMidiLearnTarget() const
+juce::AudioProcessorEditor* PluginProcessor::createEditor()
 {
-    return midiLearnTarget_.load(std::memory_order_relaxed);
+    return new PluginEditor(*this);
 }
 
-void PluginProcessor::setMidiLearnTarget(int target)
+//==============================================================================
+void PluginProcessor::getStateInformation(juce::MemoryBlock& destData)
 {
-    midiLearnTarget_.store(target, std::memory_order_relaxed);
+    writeBinaryState(*captureState(), destData);
 }
 
-void PluginProcessor::handleAsyncUpdate()
+void PluginProcessor::setStateInformation(const void* data, int sizeInBytes)
 {
-    if (onStateChanged)
-        onStateChanged();
+    auto state = std::make_unique<State>();
+
+    if (readBinaryState(data, sizeInBytes, *state))
+    {
+        applyState(*state);
+        return;
+    }
+
+    auto xml = getXmlFromBinary(data, sizeInBytes);
+    if (xml != nullptr && readXmlState(*xml, *state))
+        applyState(*state);
+}
+
+std::unique_ptr<PluginProcessor::State> PluginProcessor::captureState() const
+{
+    auto state = std::make_unique<State>();
+
+    // All maps are copied under the edit lock, so a trigger learnt meanwhile
+    // is either wholly in the snapshot or not at all
+    {
+        const juce::ScopedLock lock(triggerLock_);
+        for (int program = 0; program < kNumPrograms; ++program)
+        {
+            state->programNames[static_cast<size_t>(program)] = programNames_[static_cast<size_t>(program)];
+
+            const auto& storage = programStorage_[static_cast<size_t>(program)];
+            if (storage == nullptr)
+                continue;
+
+            const auto& maps = storage->maps;
+            if (std::all_of(maps.begin(), maps.end(), [](const TriggerMap& map) { return map.getTable().isEmpty(); }))
+                continue;
+
+            auto& tables = state->getTables(program);
+            for (size_t group = 0; group < kNumGroups; ++group)
+                tables[group] = maps[group].getTable();
+        }
+    }
+
+    state->currentProgram = currentProgram_.load(std::memory_order_acquire);
+    state->programChangeChannel = getProgramChangeChannel();
+
+    for (int group = 0; group < kNumGroups; ++group)
+        state->muted[static_cast<size_t>(group)] = isMuted(group);
+
+    state->fadeShape = getFadeShape();
+    state->lookahead = isLookaheadEnabled();
+    state->fadeTimeMs = juce::roundToInt(fadeTimeValue_->load(std::memory_order_relaxed));
+    state->learnMode = getLearnMode();
+    state->patternWindowMs = getPatternWindow();
+
+    for (int group = 0; group < kNumGroups; ++group)
+    {
+        state->feedback[static_cast<size_t>(group)] = feedback_.getMessages(group);
+        state->feedbackFromTriggers[static_cast<size_t>(group)] = isFeedbackFromTriggers(group);
+    }
+
+    state->linkGroup = getLinkGroup();
+
+    for (int action = 0; action < TriggerMap::kNumActions; ++action)
+        state->debounceMs[static_cast<size_t>(action)] = getDebounceTime(action);
+    return state;
+}
+
+void PluginProcessor::applyState(const State& state)
+{
+    {
+        // Programs the state leaves out are emptied if they have tables,
+        // and not allocated otherwise
+        const juce::ScopedLock lock(triggerLock_);
+        for (int program = 0; program < kNumPrograms; ++program)
+        {
+            programNames_[static_cast<size_t>(program)] = state.programNames[static_cast<size_t>(program)];
+
+            if (state.programs[static_cast<size_t>(program)] == nullptr
+                && programStorage_[static_cast<size_t>(program)] == nullptr)
+                continue;
+
+            auto& maps = getMaps(program);
+            for (int group = 0; group < kNumGroups; ++group)
+                maps[static_cast<size_t>(group)].edit([&](TriggerMap::Table& table) {
+                    table = state.getTable(program, group);
+                });
+        }
+    }
+
+    setCurrentProgram(state.currentProgram);
+    setProgramChangeChannel(state.programChangeChannel);
+
+    // Restoring a session is not an edit: parameters are set without a
+    // gesture, so hosts record no automation, but notified, so the values
+    // the audio thread reads follow
+    for (int group = 0; group < kNumGroups; ++group)
+    {
+        const bool muted = state.muted[static_cast<size_t>(group)];
+        requestMuted(group, muted);
+        parameters.getParameter(getMuteParameterId(group))->setValueNotifyingHost(muted ? 1.0f : 0.0f);
+    }
+
+    setFadeShape(state.fadeShape);
+    setLookahead(state.lookahead);
+    setLearnMode(state.learnMode);
+    setPatternWindow(state.patternWindowMs);
+
+    // Derived feedback is saved as it was, and derived again by the timer
+    for (int group = 0; group < kNumGroups; ++group)
+    {
+        feedback_.setMessages(group, state.feedback[static_cast<size_t>(group)]);
+        feedbackFromTriggers_[static_cast<size_t>(group)].store(state.feedbackFromTriggers[static_cast<size_t>(group)],
+                                                               std::memory_order_relaxed);
+    }
+    bumpStateVersion();
+
+    setLinkGroup(state.linkGroup);
+
+    for (int action = 0; action < TriggerMap::kNumActions; ++action)
+        setDebounceTime(action, state.debounceMs[static_cast<size_t>(action)]);
+
+    auto* fadeTime = parameters.getParameter("fadeTime");
+    fadeTime->setValueNotifyingHost(fadeTime->convertTo0to1(static_cast<float>(state.fadeTimeMs)));
+}
+
+void PluginProcessor::writeBinaryState(const State& state, juce::MemoryBlock& destData)
+{
+    juce::MemoryOutputStream stream(destData, false);
+    stream.writeInt(kStateMagic);
+    stream.writeShort(static_cast<short>(kStateVersion));
+
+    stream.writeByte(static_cast<char>(state.fadeShape));
+    stream.writeByte(state.lookahead ? 1 : 0);
+    stream.writeByte(static_cast<char>(kNumGroups));
+
+    // Program 1's triggers come first. Per group: muted flag, then the
+    // bitmap triggers.
+    for (int group = 0; group < kNumGroups; ++group)
+    {
+        stream.writeByte(state.muted[static_cast<size_t>(group)] ? 1 : 0);
+        writeTriggers(stream, state.getTable(0, group));
+    }
+
+    stream.writeShort(static_cast<short>(state.fadeTimeMs));
+
+    // Learn settings, then per group the patterns
+    stream.writeByte(static_cast<char>(state.learnMode));
+    stream.writeInt(state.patternWindowMs);
+
+    for (int group = 0; group < kNumGroups; ++group)
+        writePatterns(stream, state.getTable(0, group));
+
+    // Per group the value triggers
+    for (int group = 0; group < kNumGroups; ++group)
+        writeValueTriggers(stream, state.getTable(0, group));
+
+    // Feedback messages per group, state and slot
+    for (const auto& group : state.feedback)
+        for (const auto& messages : group)
+            for (const auto packed : messages)
+                stream.writeInt(static_cast<int>(packed));
+
+    stream.writeByte(static_cast<char>(state.linkGroup));
+
+    for (const auto ms : state.debounceMs)
+        stream.writeShort(static_cast<short>(ms));
+
+    // Program settings, every program's name, then the triggers of
+    // programs 2 and up, group by group
+    stream.writeByte(static_cast<char>(kNumPrograms));
+    stream.writeByte(static_cast<char>(state.currentProgram));
+    stream.writeByte(static_cast<char>(state.programChangeChannel));
+
+    for (const auto& name : state.programNames)
+        stream.writeString(name);
+
+    for (int program = 1; program < kNumPrograms; ++program)
+    {
+        for (int group = 0; group < kNumGroups; ++group)
+        {
+            const auto& table = state.getTable(program, group);
+            writeTriggers(stream, table);
+            writePatterns(stream, table);
+            writeValueTriggers(stream, table);
+        }
+    }
+
+    // Per group, whether feedback follows its triggers
+    for (const auto fromTriggers : state.feedbackFromTriggers)
+        stream.writeByte(fromTriggers ? 1 : 0);
+}
+
+void PluginProcessor::writeTriggers(juce::OutputStream& stream, const TriggerMap::Table& table)
+{
+    // A counted list of 16-bit triggers per action
+    for (int action = 0; action < TriggerMap::kNumActions; ++action)
+    {
+        int count = 0;
+        table.forEachTrigger(action, [&count](int32_t) { ++count; });
+
+        stream.writeShort(static_cast<short>(count));
+        table.forEachTrigger(action, [&stream](int32_t packed) {
+            stream.writeShort(static_cast<short>(packed));
+        });
+    }
+}
+
+void PluginProcessor::writePatterns(juce::OutputStream& stream, const TriggerMap::Table& table)
+{
+    const auto& patterns = table.getPatterns();
+    stream.writeByte(static_cast<char>(patterns.size()));
+
+    for (int i = 0; i < patterns.size(); ++i)
+    {
+        const auto& pattern = patterns[i];
+        stream.writeByte(static_cast<char>(pattern.action));
+        stream.writeByte(pattern.ordered ? 1 : 0);
+        stream.writeByte(static_cast<char>(pattern.numSteps));
+        stream.writeInt(pattern.windowMs);
+
+        for (int step = 0; step < pattern.numSteps; ++step)
+            stream.writeInt(pattern.keys[static_cast<size_t>(step)]);
+    }
+}
+
+void PluginProcessor::writeValueTriggers(juce::OutputStream& stream, const TriggerMap::Table& table)
+{
+    const auto& values = table.getValueTriggers();
+    stream.writeByte(static_cast<char>(values.size()));
+
+    for (int i = 0; i < values.size(); ++i)
+    {
+        const auto& trigger = values[i];
+        stream.writeInt(trigger.key);
+        stream.writeByte(static_cast<char>(trigger.action));
+        stream.writeByte(static_cast<char>(trigger.mode));
+        stream.writeShort(static_cast<short>(trigger.low));
+        stream.writeShort(static_cast<short>(trigger.high));
+        stream.writeShort(static_cast<short>(trigger.threshold));
+        stream.writeShort(static_cast<short>(trigger.hysteresis));
+    }
+}
+
+bool PluginProcessor::readBinaryState(const void* data, int sizeInBytes, State& state)
+{
+    juce::MemoryInputStream stream(data, static_cast<size_t>(juce::jmax(0, sizeInBytes)), false);
+    if (stream.getNumBytesRemaining() < 9 || stream.readInt() != kStateMagic)
+        return false;
+
+    // Other formats are not guessed at
+    if (stream.readShort() != kStateVersion)
+        return false;
+
+    const int shape = stream.readByte();
+    state.fadeShape = static_cast<CrossFader::Shape>(juce::jlimit(0, 3, shape));
+    state.lookahead = stream.readByte() != 0;
+    const int numGroups = stream.readByte();
+
+    // Groups or programs beyond ours, written by a wider build, are read
+    // and dropped
+    TriggerMap::Table ignored;
+
+    const auto getTable = [&state, &ignored](int program, int group) -> TriggerMap::Table& {
+        if (program < kNumPrograms && group < kNumGroups)
+            return state.getTables(program)[static_cast<size_t>(group)];
+        return ignored;
+    };
+
+    for (int group = 0; group < numGroups; ++group)
+    {
+        if (stream.getNumBytesRemaining() < 1)
+            return false;
+
+        const bool muted = stream.readByte() != 0;
+        if (group < kNumGroups)
+            state.muted[static_cast<size_t>(group)] = muted;
+
+        if (! readTriggers(stream, getTable(0, group)))
+            return false;
+    }
+
+    if (stream.getNumBytesRemaining() < 7)
+        return false;
+
+    state.fadeTimeMs = juce::jlimit(1, kMaxFadeTimeMs, static_cast<int>(stream.readShort()));
+
+    const int learnMode = stream.readByte();
+    state.learnMode = static_cast<LearnMode>(juce::jlimit(0, 3, learnMode));
+    state.patternWindowMs = juce::jmax(0, stream.readInt());
+
+    for (int group = 0; group < numGroups; ++group)
+        if (! readPatterns(stream, getTable(0, group)))
+            return false;
+
+    for (int group = 0; group < numGroups; ++group)
+        if (! readValueTriggers(stream, getTable(0, group)))
+            return false;
+
+    constexpr int messagesPerGroup = MidiFeedback::kNumStates * MidiFeedback::kMaxMessages;
+    if (stream.getNumBytesRemaining() < 4 * messagesPerGroup * numGroups)
+        return false;
+
+    for (int group = 0; group < numGroups; ++group)
+    {
+        for (int i = 0; i < messagesPerGroup; ++i)
+        {
+            const auto packed = static_cast<uint32_t>(stream.readInt());
+            if (group < kNumGroups)
+                state.feedback[static_cast<size_t>(group)][static_cast<size_t>(i / MidiFeedback::kMaxMessages)]
+                              [static_cast<size_t>(i % MidiFeedback::kMaxMessages)] = packed;
+        }
+    }
+
+    if (stream.getNumBytesRemaining() < 1 + 2 * TriggerMap::kNumActions + 3)
+        return false;
+
+    const int linkGroup = stream.readByte();
+    state.linkGroup = juce::jlimit(0, LinkRegistry::kNumLinks, linkGroup);
+
+    for (auto& ms : state.debounceMs)
+        ms = juce::jmax(0, static_cast<int>(stream.readShort()));
+
+    const int numPrograms = stream.readByte() & 0xFF;
+    const int currentProgram = stream.readByte();
+    const int programChangeChannel = stream.readByte();
+    state.currentProgram = juce::jlimit(0, kNumPrograms - 1, currentProgram);
+    state.programChangeChannel = juce::jlimit(kProgramChangeOff, kProgramChangeAny, programChangeChannel);
+
+    for (int program = 0; program < numPrograms; ++program)
+    {
+        if (stream.isExhausted())
+            return false;
+
+        const auto name = stream.readString();
+        if (program < kNumPrograms)
+            state.programNames[static_cast<size_t>(program)] = name;
+    }
+
+    for (int program = 1; program < numPrograms; ++program)
+    {
+        for (int group = 0; group < numGroups; ++group)
+        {
+            auto& table = getTable(program, group);
+            if (! readTriggers(stream, table) || ! readPatterns(stream, table) || ! readValueTriggers(stream, table))
+                return false;
+        }
+    }
+
+    if (stream.getNumBytesRemaining() < numGroups)
+        return false;
+
+    for (int group = 0; group < numGroups; ++group)
+    {
+        const bool fromTriggers = stream.readByte() != 0;
+        if (group < kNumGroups)
+            state.feedbackFromTriggers[static_cast<size_t>(group)] = fromTriggers;
+    }
+
+    // Every program is written, so the empty ones are dropped again
+    for (auto& tables : state.programs)
+        if (tables != nullptr && std::all_of(tables->begin(), tables->end(), [](const TriggerMap::Table& table) { return table.isEmpty(); }))
+            tables.reset();
+
+    return true;
+}
+
+bool PluginProcessor::readTriggers(juce::InputStream& stream, TriggerMap::Table& table)
+{
+    for (int action = 0; action < TriggerMap::kNumActions; ++action)
+    {
+        if (stream.getNumBytesRemaining() < 2)
+            return false;
+
+        const int count = stream.readShort() & 0xFFFF;
+        if (stream.getNumBytesRemaining() < 2 * count)
+            return false;
+
+        for (int i = 0; i < count; ++i)
+            table.add(action, stream.readShort() & 0xFFFF);
+    }
+
+    return true;
+}
+
+bool PluginProcessor::readPatterns(juce::InputStream& stream, TriggerMap::Table& table)
+{
+    if (stream.getNumBytesRemaining() < 1)
+        return false;
+
+    const int count = stream.readByte() & 0xFF;
+    for (int i = 0; i < count; ++i)
+    {
+        if (stream.getNumBytesRemaining() < 7)
+            return false;
+
+        PatternTriggers::Pattern pattern;
+        pattern.action = stream.readByte();
+        pattern.ordered = stream.readByte() != 0;
+        const int numSteps = stream.readByte() & 0xFF;
+        pattern.windowMs = juce::jmax(0, stream.readInt());
+
+        if (stream.getNumBytesRemaining() < 4 * numSteps)
+            return false;
+
+        for (int step = 0; step < numSteps; ++step)
+        {
+            const int key = stream.readInt();
+            if (step < PatternTriggers::kMaxSteps)
+                pattern.keys[static_cast<size_t>(step)] = key;
+        }
+
+        // Longer patterns, from a wider build, can't be matched here
+        pattern.numSteps = numSteps;
+        if (numSteps <= PatternTriggers::kMaxSteps)
+            table.addPattern(pattern);
+    }
+
+    return true;
+}
+
+bool PluginProcessor::readValueTriggers(juce::InputStream& stream, TriggerMap::Table& table)
+{
+    if (stream.getNumBytesRemaining() < 1)
+        return false;
+
+    const int count = stream.readByte() & 0xFF;
+    if (stream.getNumBytesRemaining() < 14 * count)
+        return false;
+
+    for (int i = 0; i < count; ++i)
+    {
+        ValueTriggers::Trigger trigger;
+        trigger.key = stream.readInt();
+        trigger.action = stream.readByte();
+        const int mode = stream.readByte();
+        trigger.mode = static_cast<ValueTriggers::Mode>(juce::jlimit(0, 2, mode));
+        trigger.low = stream.readShort();
+        trigger.high = stream.readShort();
+        trigger.threshold = stream.readShort();
+        trigger.hysteresis = stream.readShort();
+        table.addValueTrigger(trigger);
+    }
+
+    return true;
+}
+
+bool PluginProcessor::readXmlState(const juce::XmlElement& xml, State& state)
+{
+    if (! xml.hasTagName("Semaforte"))
+        return false;
+
+    // Version 1 had one group; unassigned (-1) slots are ignored by add()
+    auto& table = state.getTables(0)[0];
+
+    if (auto* stopXml = xml.getChildByName("stopTriggers"))
+        for (auto* trigger : stopXml->getChildIterator())
+            table.add(0, trigger->getAllSubText().getIntValue());
+
+    if (auto* goXml = xml.getChildByName("goTriggers"))
+        for (auto* trigger : goXml->getChildIterator())
+            table.add(1, trigger->getAllSubText().getIntValue());
+
+    state.muted[0] = xml.getBoolAttribute("muted", false);
+    return true;
+}
+
+//==============================================================================
+juce::Array<int32_t> PluginProcessor::getTriggers(int group, int button) const
+{
+    const juce::ScopedLock lock(triggerLock_);
+    return getCurrentTable(group).getTriggers(button);
+}
+
+juce::Array<PatternTriggers::Pattern> PluginProcessor::getPatterns(int group, int button) const
+{
+    juce::Array<PatternTriggers::Pattern> result;
+
+    const juce::ScopedLock lock(triggerLock_);
+    const auto& patterns = getCurrentTable(group).getPatterns();
+    for (int i = 0; i < patterns.size(); ++i)
+        if (patterns[i].action == button)
+            result.add(patterns[i]);
+
+    return result;
+}
+
+juce::Array<ValueTriggers::Trigger> PluginProcessor::getValueTriggers(int group, int button) const
+{
+    juce::Array<ValueTriggers::Trigger> result;
+
+    const juce::ScopedLock lock(triggerLock_);
+    const auto& values = getCurrentTable(group).getValueTriggers();
+    for (int i = 0; i < values.size(); ++i)
+        if (values[i].action == button)
+            result.add(values[i]);
+
+    return result;
+}
+
+void PluginProcessor::addTrigger(int group, int button, int32_t trigger)
+{
+    const juce::ScopedLock lock(triggerLock_);
+    getMaps(getCurrentProgram())[static_cast<size_t>(group)].edit([button, trigger](TriggerMap::Table& table) {
+        table.add(button, trigger);
+    });
+    bumpStateVersion();
+}
+
+void PluginProcessor::clearTriggers(int group, int button)
+{
+    const juce::ScopedLock lock(triggerLock_);
+    getMaps(getCurrentProgram())[static_cast<size_t>(group)].edit([button](TriggerMap::Table& table) {
+        table.clear(button);
+    });
+    bumpStateVersion();
+}
+
+bool PluginProcessor::isMuted(int group) const
+{
+    return groupStatus_[static_cast<size_t>(group)].muted.load(std::memory_order_relaxed);
+}
+
+void PluginProcessor::setMuted(int group, bool muted)
+{
+    requestMuted(group, muted);
+
+    // Let the host record it; the audio thread has the request already and
+    // applying the parameter change as well is a no-op
+    auto* parameter = parameters.getParameter(getMuteParameterId(group));
+    parameter->beginChangeGesture();
+    parameter->setValueNotifyingHost(muted ? 1.0f : 0.0f);
+    parameter->endChangeGesture();
+}
+
+void PluginProcessor::requestMuted(int group, bool muted)
+{
+    auto& status = groupStatus_[static_cast<size_t>(group)];
+    status.muted.store(muted, std::memory_order_relaxed);
+    status.muteRequest.store(muted ? 1 : 0, std::memory_order_release);
+    bumpStateVersion();
+}
+
+int PluginProcessor::getMidiLearnTarget(int group) const
+{
+    return groupStatus_[static_cast<size_t>(group)].midiLearnTarget.load(std::memory_order_relaxed);
+}
+
+void PluginProcessor::setMidiLearnTarget(int group, int target)
+{
+    groupStatus_[static_cast<size_t>(group)].midiLearnTarget.store(target, std::memory_order_relaxed);
+    bumpStateVersion();
+}
+
+void PluginProcessor::setFeedbackMessage(int group, MidiFeedback::State state, int slot, const juce::MidiMessage& message)
+{
+    // Hand-set messages are kept as they are
+    feedbackFromTriggers_[static_cast<size_t>(group)].store(false, std::memory_order_relaxed);
+    feedback_.setMessage(group, state, slot, MidiFeedback::pack(message));
+    bumpStateVersion();
+}
+
+bool PluginProcessor::hasFeedback(int group) const
+{
+    return feedback_.hasMessages(group);
+}
+
+void PluginProcessor::setFeedbackFromTriggers(int group, bool enabled)
+{
+    feedbackFromTriggers_[static_cast<size_t>(group)].store(enabled, std::memory_order_relaxed);
+    if (enabled)
+        deriveFeedback(group);
+    else
+        feedback_.setMessages(group, {});
+
+    bumpStateVersion();
+}
+
+bool PluginProcessor::isFeedbackFromTriggers(int group) const
+{
+    return feedbackFromTriggers_[static_cast<size_t>(group)].load(std::memory_order_relaxed);
+}
+
+void PluginProcessor::deriveFeedback(int group)
+{
+    // Notes and controllers can be echoed at a brightness, other triggers not
+    const auto echo = [](const juce::Array<int32_t>& triggers, int brightness) {
+        for (const auto trigger : triggers)
+        {
+            const int status = (trigger >> 8) & 0xFF;
+            const int channel = (status & 0x0F) + 1;
+            if ((status & 0xF0) == 0x90)
+                return MidiFeedback::pack(juce::MidiMessage::noteOn(channel, trigger & 0x7F, static_cast<juce::uint8>(brightness)));
+            if ((status & 0xF0) == 0xB0)
+                return MidiFeedback::pack(juce::MidiMessage::controllerEvent(channel, trigger & 0x7F, brightness));
+        }
+        return uint32_t { 0 };
+    };
+
+    const auto stop = getTriggers(group, 0);
+    const auto go = getTriggers(group, 1);
+
+    const std::array<std::pair<int, int>, MidiFeedback::kNumStates> brightness { {
+        { 127, 0 },     // muted
+        { 0, 127 },     // unmuted
+        { 64, 0 },      // learning stop
+        { 0, 64 },      // learning go
+    } };
+
+    MidiFeedback::Messages messages;
+    for (size_t s = 0; s < messages.size(); ++s)
+        messages[s] = { echo(stop, brightness[s].first), echo(go, brightness[s].second) };
+
+    // Unchanged feedback isn't sent again
+    if (messages != feedback_.getMessages(group))
+        feedback_.setMessages(group, messages);
+}
+
+int PluginProcessor::getDebounceTime(int action) const
+{
+    return midiDebouncer_.getWindow(action);
+}
+
+void PluginProcessor::setDebounceTime(int action, int ms)
+{
+    midiDebouncer_.setWindow(action, ms);
+    bumpStateVersion();
+}
+
+int PluginProcessor::getLinkGroup() const
+{
+    return linkGroup_.load(std::memory_order_relaxed);
+}
+
+void PluginProcessor::setLinkGroup(int link)
+{
+    linkGroup_.store(juce::jlimit(0, LinkRegistry::kNumLinks, link), std::memory_order_relaxed);
+    bumpStateVersion();
+}
+
+PluginProcessor::LearnMode PluginProcessor::getLearnMode() const
+{
+    return learnMode_.load(std::memory_order_relaxed);
+}
+
+void PluginProcessor::setLearnMode(LearnMode mode)
+{
+    learnMode_.store(mode, std::memory_order_relaxed);
+    bumpStateVersion();
+}
+
+int PluginProcessor::getPatternWindow() const
+{
+    return patternWindow_.load(std::memory_order_relaxed);
+}
+
+void PluginProcessor::setPatternWindow(int ms)
+{
+    patternWindow_.store(juce::jmax(0, ms), std::memory_order_relaxed);
+    bumpStateVersion();
+}
+
+CrossFader::Shape PluginProcessor::getFadeShape() const
+{
+    return fadeShape_.load(std::memory_order_relaxed);
+}
+
+void PluginProcessor::setFadeShape(CrossFader::Shape shape)
+{
+    fadeShape_.store(shape, std::memory_order_relaxed);
+    bumpStateVersion();
+}
+
+bool PluginProcessor::isLookaheadEnabled() const
+{
+    return lookaheadEnabled_.load(std::memory_order_relaxed);
+}
+
+void PluginProcessor::setLookahead(bool enabled)
+{
+    lookaheadEnabled_.store(enabled, std::memory_order_relaxed);
+    setLatencySamples(enabled ? lookaheadSamples_.load(std::memory_order_relaxed) : 0);
+    bumpStateVersion();
+}
+
+Metrics PluginProcessor::getMetrics() const
+{
+    return publishedMetrics_.read();
+}
+
+juce::uint32 PluginProcessor::getStateVersion() const
+{
+    return stateVersion_.load(std::memory_order_acquire);
+}
+
+void PluginProcessor::bumpStateVersion()
+{
+    stateVersion_.fetch_add(1, std::memory_order_release);
+}
+
+void PluginProcessor::timerCallback()
+{
+    // Add triggers learnt on the audio thread
+    for (LearntTrigger trigger; learntTriggers_.pop(trigger);)
+        addLearnt(trigger);
+
+    // Close gestures whose window has passed or whose learning has ended
+    const auto now = publishedClock_.load(std::memory_order_relaxed);
+
+    for (int group = 0; group < kNumGroups; ++group)
+    {
+        const auto& gesture = gestures_[static_cast<size_t>(group)];
+        if (gesture.active && (getMidiLearnTarget(group) != gesture.pattern.action
+                               || now - gesture.started > gesture.windowSamples))
+            finishGesture(group);
+    }
+
+    // Trigger edits and program switches, from any thread, bump the version
+    if (const auto version = getStateVersion(); version != feedbackVersion_)
+    {
+        feedbackVersion_ = version;
+        for (int group = 0; group < kNumGroups; ++group)
+            if (isFeedbackFromTriggers(group))
+                deriveFeedback(group);
+    }
+
+    reportMutes();
+}
+
+void PluginProcessor::reportMutes()
+{
+    // Mutes from MIDI and links are copied to the mute parameters, so host
+    // automation sees them and a value it sends again is a change
+    for (int group = 0; group < kNumGroups; ++group)
+    {
+        auto& status = groupStatus_[static_cast<size_t>(group)];
+        if (! status.muteUnreported.exchange(false, std::memory_order_acquire))
+            continue;
+
+        const bool muted = isMuted(group);
+        auto* parameter = parameters.getParameter(getMuteParameterId(group));
+        if ((parameter->getValue() >= 0.5f) == muted)
+            continue;
+
+        status.muteReported.store(muted ? 1 : 0, std::memory_order_release);
+        parameter->beginChangeGesture();
+        parameter->setValueNotifyingHost(muted ? 1.0f : 0.0f);
+        parameter->endChangeGesture();
+    }
+}
+
+void PluginProcessor::addLearnt(const LearntTrigger& trigger)
+{
+    auto& gesture = gestures_[static_cast<size_t>(trigger.group)];
+    if (gesture.active && (trigger.button != gesture.pattern.action
+                           || trigger.time - gesture.started > gesture.windowSamples))
+        finishGesture(trigger.group);
+
+    // Only threshold learning follows values
+    if (trigger.refinement && (! gesture.active || gesture.mode != LearnMode::threshold))
+        return;
+
+    auto& pattern = gesture.pattern;
+
+    if (! gesture.active)
+    {
+        gesture.mode = getLearnMode();
+        gesture.started = trigger.time;
+        gesture.active = true;
+
+        // A single trigger's gesture lasts as long as the debouncer would
+        // ignore what follows it
+        pattern = {};
+        pattern.action = trigger.button;
+        pattern.ordered = gesture.mode == LearnMode::sequence;
+        pattern.windowMs = gesture.mode == LearnMode::single ? getDebounceTime(trigger.button) : getPatternWindow();
+        gesture.windowSamples = static_cast<juce::int64>(getSampleRate() * pattern.windowMs * 0.001);
+    }
+
+    if (gesture.mode == LearnMode::threshold)
+    {
+        // Follow one key; a composite key takes over from the raw
+        // controllers it arrives in
+        const bool composite = MidiDecoder::getKind(trigger.trigger) != MidiDecoder::Kind::raw;
+        if (pattern.numSteps == 0 || (composite && MidiDecoder::getKind(pattern.keys[0]) == MidiDecoder::Kind::raw))
+        {
+            pattern.keys[0] = trigger.trigger;
+            pattern.numSteps = 1;
+            gesture.firstValue = trigger.value;
+        }
+        else if (trigger.trigger != pattern.keys[0])
+        {
+            return;
+        }
+
+        gesture.lastValue = trigger.value;
+        return;
+    }
+
+    auto* const keys = pattern.keys.data();
+    auto* end = keys + pattern.numSteps;
+
+    // A 14-bit controller's MSB came in first as a plain CC
+    if (MidiDecoder::getKind(trigger.trigger) == MidiDecoder::Kind::cc14)
+    {
+        const int32_t msb = ((0xB0 | MidiDecoder::getChannel(trigger.trigger)) << 8) | MidiDecoder::getNumber(trigger.trigger);
+        end = std::remove(keys, end, msb);
+        pattern.numSteps = static_cast<int>(end - keys);
+    }
+
+    // Chords hold each key once
+    if (pattern.numSteps == PatternTriggers::kMaxSteps || (! pattern.ordered && std::find(keys, end, trigger.trigger) != end))
+        return;
+
+    keys[pattern.numSteps++] = trigger.trigger;
+}
+
+void PluginProcessor::addValueTrigger(int group, const Gesture& gesture)
+{
+    ValueTriggers::Trigger trigger;
+    trigger.key = gesture.pattern.keys[0];
+    trigger.action = gesture.pattern.action;
+
+    // A movement learns a crossing halfway along it, with a sixteenth of
+    // the range as hysteresis. A single value, such as a note's velocity,
+    // learns the range from half of it upwards.
+    const int maxValue = MidiDecoder::getKind(trigger.key) == MidiDecoder::Kind::raw ? 127 : 16383;
+    if (gesture.lastValue != gesture.firstValue)
+    {
+        trigger.mode = gesture.lastValue > gesture.firstValue ? ValueTriggers::Mode::rising : ValueTriggers::Mode::falling;
+        trigger.threshold = (gesture.firstValue + gesture.lastValue) / 2;
+        trigger.hysteresis = (maxValue + 1) / 16;
+    }
+    else
+    {
+        trigger.mode = ValueTriggers::Mode::range;
+        trigger.low = gesture.firstValue / 2;
+        trigger.high = maxValue;
+    }
+
+    const juce::ScopedLock lock(triggerLock_);
+    getMaps(getCurrentProgram())[static_cast<size_t>(group)].edit([&trigger](TriggerMap::Table& table) {
+        table.addValueTrigger(trigger);
+    });
+    bumpStateVersion();
+}
+
+void PluginProcessor::finishGesture(int group)
+{
+    auto& gesture = gestures_[static_cast<size_t>(group)];
+    gesture.active = false;
+
+    const auto& pattern = gesture.pattern;
+    if (pattern.numSteps == 0)
+        return;
+
+    if (gesture.mode == LearnMode::threshold)
+    {
+        addValueTrigger(group, gesture);
+        return;
+    }
+
+    if (gesture.mode == LearnMode::single || pattern.numSteps == 1)
+    {
+        // One trigger per gesture; a composite key names it better than
+        // the controllers it arrived in
+        const auto* const keys = pattern.keys.data();
+        const auto* const end = keys + pattern.numSteps;
+        const auto* composite = std::find_if(keys, end, [](int32_t key) {
+            return MidiDecoder::getKind(key) != MidiDecoder::Kind::raw;
+        });
+
+        addTrigger(group, pattern.action, composite != end ? *composite : keys[0]);
+        return;
+    }
+
+    const juce::ScopedLock lock(triggerLock_);
+    getMaps(getCurrentProgram())[static_cast<size_t>(group)].edit([&pattern](TriggerMap::Table& table) {
+        table.addPattern(pattern);
+    });
+    bumpStateVersion();
 }
 
 //==============================================================================
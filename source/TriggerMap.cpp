@@ -0,0 +1,161 @@
+#include "TriggerMap.h"
+#include <thread>
+
+//==============================================================================
+int TriggerMap::Table::keyIndex(int32_t packed)
+{
+    const int status = (packed >> 8) & 0xFF;
+    if (packed < 0 || packed > 0xFFFF || status < 0x80)
+        return -1;
+
+    return ((status & 0x7F) << 7) | (packed & 0x7F);
+}
+
+int TriggerMap::Table::lookup(int32_t packed) const
+{
+    const int key = keyIndex(packed);
+    if (key < 0)
+        return kNoAction;
+
+    const auto word = static_cast<size_t>(key >> 6);
+    const auto mask = uint64_t { 1 } << (key & 63);
+
+    // Stop has priority over go
+    for (int action = 0; action < kNumActions; ++action)
+        if ((bits_[static_cast<size_t>(action)][word] & mask) != 0)
+            return action;
+
+    return kNoAction;
+}
+
+void TriggerMap::Table::add(int action, int32_t packed)
+{
+    if (! juce::isPositiveAndBelow(action, kNumActions))
+        return;
+
+    if (packed > 0xFFFF)
+    {
+        PatternTriggers::Pattern pattern;
+        pattern.keys[0] = packed;
+        pattern.numSteps = 1;
+        pattern.action = action;
+        addPattern(pattern);
+        return;
+    }
+
+    const int key = keyIndex(packed);
+    if (key < 0)
+        return;
+
+    const auto word = static_cast<size_t>(key >> 6);
+    const auto mask = uint64_t { 1 } << (key & 63);
+
+    for (auto& bits : bits_)
+        bits[word] &= ~mask;
+
+    bits_[static_cast<size_t>(action)][word] |= mask;
+}
+
+bool TriggerMap::Table::addPattern(const PatternTriggers::Pattern& pattern)
+{
+    return juce::isPositiveAndBelow(pattern.action, kNumActions) && patterns_.add(pattern);
+}
+
+bool TriggerMap::Table::addValueTrigger(const ValueTriggers::Trigger& trigger)
+{
+    if (! juce::isPositiveAndBelow(trigger.action, kNumActions) || ! values_.add(trigger))
+        return false;
+
+    const int key = keyIndex(trigger.key);
+    if (key >= 0)
+        for (auto& bits : bits_)
+            bits[static_cast<size_t>(key >> 6)] &= ~(uint64_t { 1 } << (key & 63));
+
+    return true;
+}
+
+void TriggerMap::Table::clear(int action)
+{
+    if (! juce::isPositiveAndBelow(action, kNumActions))
+        return;
+
+    bits_[static_cast<size_t>(action)].fill(0);
+    patterns_.clear(action);
+    values_.clear(action);
+}
+
+void TriggerMap::Table::clearAll()
+{
+    for (auto& bits : bits_)
+        bits.fill(0);
+    patterns_.clearAll();
+    values_.clearAll();
+}
+
+bool TriggerMap::Table::isEmpty() const
+{
+    for (const auto& bits : bits_)
+        for (const auto word : bits)
+            if (word != 0)
+                return false;
+
+    return patterns_.size() == 0 && values_.size() == 0;
+}
+
+juce::Array<int32_t> TriggerMap::Table::getTriggers(int action) const
+{
+    juce::Array<int32_t> triggers;
+    forEachTrigger(action, [&triggers](int32_t packed) { triggers.add(packed); });
+    return triggers;
+}
+
+//==============================================================================
+const TriggerMap::Table& TriggerMap::beginRead()
+{
+    // Enter before loading the pointer; pairs with the seq_cst store in publish()
+    readEpoch_.fetch_add(1, std::memory_order_seq_cst);
+    return *current_.load(std::memory_order_seq_cst);
+}
+
+void TriggerMap::endRead()
+{
+    readEpoch_.fetch_add(1, std::memory_order_release);
+}
+
+//==============================================================================
+TriggerMap::TriggerMap()
+    : current_(&tables_[0])
+{
+}
+
+const TriggerMap::Table& TriggerMap::getTable() const
+{
+    return *current_.load(std::memory_order_acquire);
+}
+
+TriggerMap::Table& TriggerMap::beginEdit()
+{
+    // Grace period of the last publish: a reader that entered before the
+    // swap may still hold the spare table. Wait for it to leave.
+    if (spareReader_ != kNoReader)
+    {
+        while (readEpoch_.load(std::memory_order_acquire) == spareReader_)
+            std::this_thread::yield();
+        spareReader_ = kNoReader;
+    }
+
+    const auto* current = current_.load(std::memory_order_relaxed);
+    auto& spare = (current == &tables_[0]) ? tables_[1] : tables_[0];
+    spare = *current;
+    return spare;
+}
+
+void TriggerMap::publish(Table& table)
+{
+    current_.store(&table, std::memory_order_seq_cst);
+
+    // Readers entering from now on load the new table; one inside now may
+    // hold the old one until its epoch moves on
+    const auto epoch = readEpoch_.load(std::memory_order_seq_cst);
+    spareReader_ = (epoch & 1) != 0 ? epoch : kNoReader;
+}
@@ -0,0 +1,164 @@
+#include "ValueTriggers.h"
+#include <algorithm>
+#include <atomic>
+
+namespace ValueTriggers
+{
+namespace
+{
+    int lowestBit(uint32_t bits)
+    {
+        return juce::countNumberOfBits((bits & (~bits + 1)) - 1);
+    }
+
+    /** Every note on is a strike of its own, controllers are levels */
+    bool isStrike(int32_t key)
+    {
+        return key <= 0xFFFF && ((key >> 8) & 0xF0) == 0x90;
+    }
+}
+
+//==============================================================================
+bool Trigger::hasSameCondition(const Trigger& other) const
+{
+    if (key != other.key || mode != other.mode)
+        return false;
+
+    if (mode == Mode::range)
+        return low == other.low && high == other.high;
+
+    return threshold == other.threshold && hysteresis == other.hysteresis;
+}
+
+//==============================================================================
+bool Set::add(const Trigger& trigger)
+{
+    auto* const end = triggers_.data() + numTriggers_;
+    auto* existing = std::find_if(triggers_.data(), end, [&trigger](const Trigger& t) { return t.hasSameCondition(trigger); });
+
+    if (existing == end)
+    {
+        if (numTriggers_ == kMaxTriggers)
+            return false;
+        ++numTriggers_;
+    }
+
+    *existing = trigger;
+    compile();
+    return true;
+}
+
+void Set::clear(int action)
+{
+    auto* const end = triggers_.data() + numTriggers_;
+    numTriggers_ = static_cast<int>(std::remove_if(triggers_.data(), end, [action](const Trigger& t) { return t.action == action; })
+                                    - triggers_.data());
+    compile();
+}
+
+void Set::clearAll()
+{
+    numTriggers_ = 0;
+    compile();
+}
+
+int Set::hash(int32_t key)
+{
+    // Fibonacci hashing, top 6 bits
+    return static_cast<int>((static_cast<uint32_t>(key) * 2654435761u) >> 26);
+}
+
+uint32_t Set::lookup(int32_t key) const
+{
+    // Terminates: the index is never more than half full
+    for (int i = hash(key);; i = (i + 1) & (kIndexSize - 1))
+    {
+        const auto& slot = index_[static_cast<size_t>(i)];
+        if (slot.key == key)
+            return slot.triggers;
+        if (slot.key == kEmptyKey)
+            return 0;
+    }
+}
+
+void Set::compile()
+{
+    index_.fill({});
+
+    for (int t = 0; t < numTriggers_; ++t)
+    {
+        const auto key = triggers_[static_cast<size_t>(t)].key;
+        int i = hash(key);
+        while (index_[static_cast<size_t>(i)].key != kEmptyKey && index_[static_cast<size_t>(i)].key != key)
+            i = (i + 1) & (kIndexSize - 1);
+
+        index_[static_cast<size_t>(i)].key = key;
+        index_[static_cast<size_t>(i)].triggers |= 1u << t;
+    }
+
+    // Unique across all sets, so a matcher notices a table restored from state
+    static std::atomic<uint32_t> generations { 0 };
+    generation_ = ++generations;
+}
+
+//==============================================================================
+void Matcher::reset()
+{
+    known_ = armed_ = inside_ = 0;
+}
+
+int Matcher::process(const Set& set, int32_t key, int value)
+{
+    if (set.getGeneration() != generation_)
+    {
+        reset();
+        generation_ = set.getGeneration();
+    }
+
+    int result = kNoAction;
+
+    for (auto triggers = set.lookup(key); triggers != 0; triggers &= triggers - 1)
+    {
+        const int index = lowestBit(triggers);
+        const auto bit = 1u << index;
+        const auto& trigger = set[index];
+        const bool known = (known_ & bit) != 0;
+        bool fire = false;
+
+        switch (trigger.mode)
+        {
+            case Mode::range:
+            {
+                // A level fires on entering the range, a strike whenever it's in it
+                const bool inside = value >= trigger.low && value <= trigger.high;
+                fire = inside && ((inside_ & bit) == 0 || isStrike(key));
+                inside_ = inside ? (inside_ | bit) : (inside_ & ~bit);
+                break;
+            }
+
+            case Mode::rising:
+                // The first value only arms if it's below the threshold,
+                // since nothing is known about how it got there
+                if (value < trigger.threshold - trigger.hysteresis || (! known && value < trigger.threshold))
+                    armed_ |= bit;
+                fire = (armed_ & bit) != 0 && value >= trigger.threshold;
+                break;
+
+            case Mode::falling:
+                if (value > trigger.threshold + trigger.hysteresis || (! known && value > trigger.threshold))
+                    armed_ |= bit;
+                fire = (armed_ & bit) != 0 && value <= trigger.threshold;
+                break;
+        }
+
+        known_ |= bit;
+        if (! fire)
+            continue;
+
+        armed_ &= ~bit;
+        result = (result == kNoAction) ? trigger.action : juce::jmin(result, trigger.action);
+    }
+
+    return result;
+}
+}
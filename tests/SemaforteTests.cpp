@@ -0,0 +1,327 @@
+/*
+  ==============================================================================
+
+    SemaforteTests
+    Property tests for block partitioning: the same MIDI stream must give the
+    same decisions however the host splits it into blocks. Random event
+    streams are run through MidiDebouncer and PluginProcessor under random
+    partitions of 1 to 4096 samples and compared against a fixed partition.
+    Saved state is also restored and saved again, which must not change it.
+
+    Usage: SemaforteTests [--iterations=N] [--seed=N]
+
+  ==============================================================================
+*/
+
+#include "PluginProcessor.h"
+#include <juce_core/juce_core.h>
+#include <array>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+namespace
+{
+    constexpr double kSampleRate = 48000.0;
+    constexpr int kMaxBlockSize = 4096;
+    constexpr int kFixedBlockSize = 512;
+
+    // Few enough that no block can hit the debouncer's per-block cap or the
+    // feedback pool, both of which depend on the partition by design
+    constexpr int kMaxEvents = 48;
+
+    struct Event
+    {
+        juce::int64 time = 0;
+        juce::MidiMessage message;
+    };
+
+    /** Note ons and offs on channel 1, bunched so that some fall inside the
+        debounce windows */
+    std::vector<Event> makeStream(juce::Random& random, juce::int64 length)
+    {
+        std::vector<Event> events;
+        const int numEvents = 1 + random.nextInt(kMaxEvents);
+        juce::int64 time = 0;
+
+        for (int i = 0; i < numEvents; ++i)
+        {
+            time += random.nextBool() ? random.nextInt(480) : random.nextInt(static_cast<int>(2 * length / numEvents));
+            if (time >= length)
+                break;
+
+            const int note = 36 + random.nextInt(16);
+            const auto message = random.nextInt(4) == 0 ? juce::MidiMessage::noteOff(1, note)
+                                                        : juce::MidiMessage::noteOn(1, note, static_cast<juce::uint8>(100));
+            events.push_back({ time, message });
+        }
+
+        return events;
+    }
+
+    /** Block sizes adding up to length: mostly anything up to the maximum,
+        sometimes tiny */
+    std::vector<int> makePartition(juce::Random& random, juce::int64 length)
+    {
+        std::vector<int> sizes;
+        for (juce::int64 covered = 0; covered < length;)
+        {
+            const int size = random.nextInt(4) == 0 ? 1 + random.nextInt(16) : 1 + random.nextInt(kMaxBlockSize);
+            sizes.push_back(static_cast<int>(juce::jmin(static_cast<juce::int64>(size), length - covered)));
+            covered += sizes.back();
+        }
+        return sizes;
+    }
+
+    std::vector<int> makeFixedPartition(juce::int64 length)
+    {
+        std::vector<int> sizes;
+        for (juce::int64 covered = 0; covered < length; covered += sizes.back())
+            sizes.push_back(static_cast<int>(juce::jmin(static_cast<juce::int64>(kFixedBlockSize), length - covered)));
+        return sizes;
+    }
+
+    /** The stream's events that fall in [start, start + size), block-relative */
+    juce::MidiBuffer getBlock(const std::vector<Event>& events, juce::int64 start, int size)
+    {
+        juce::MidiBuffer midi;
+        for (const auto& event : events)
+            if (event.time >= start && event.time < start + size)
+                midi.addEvent(event.message, static_cast<int>(event.time - start));
+        return midi;
+    }
+
+    //==============================================================================
+    struct Decision
+    {
+        juce::int64 time = 0;
+        int32_t trigger = 0;
+        int action = 0;
+        bool accepted = false;
+
+        bool operator==(const Decision& other) const
+        {
+            return time == other.time && trigger == other.trigger && action == other.action && accepted == other.accepted;
+        }
+    };
+
+    std::vector<Decision> runDebouncer(const std::vector<Event>& events, const std::vector<int>& partition,
+                                       const std::array<int, MidiDebouncer::kNumActions>& windowsMs)
+    {
+        MidiDebouncer debouncer;
+        debouncer.prepare(kSampleRate);
+        for (int action = 0; action < MidiDebouncer::kNumActions; ++action)
+            debouncer.setWindow(action, windowsMs[static_cast<size_t>(action)]);
+
+        std::vector<Decision> decisions;
+        juce::int64 start = 0;
+
+        for (const int size : partition)
+        {
+            const auto midi = getBlock(events, start, size);
+            for (const auto& event : debouncer.processBlock(midi))
+            {
+                // Even notes stop, odd ones go
+                const int32_t trigger = (event.data[0] << 8) | event.data[1];
+                const int action = event.data[1] & 1;
+                const auto time = start + event.samplePosition;
+                decisions.push_back({ time, trigger, action, debouncer.accept(trigger, action, time) });
+            }
+            start += size;
+        }
+
+        return decisions;
+    }
+
+    bool testDebouncer(juce::Random& random)
+    {
+        const auto length = static_cast<juce::int64>(kSampleRate * (1 + random.nextInt(4)));
+        const auto events = makeStream(random, length);
+        const std::array<int, MidiDebouncer::kNumActions> windowsMs { random.nextInt(50), random.nextInt(50) };
+
+        const auto expected = runDebouncer(events, makeFixedPartition(length), windowsMs);
+        const auto actual = runDebouncer(events, makePartition(random, length), windowsMs);
+
+        if (actual == expected)
+            return true;
+
+        std::fprintf(stderr, "debouncer: %d decisions against %d\n", static_cast<int>(actual.size()),
+                     static_cast<int>(expected.size()));
+        return false;
+    }
+
+    //==============================================================================
+    // Feedback is sent on channel 16 as CC 100 + group, valued by the state
+    constexpr int kFeedbackChannel = 16;
+
+    struct Trace
+    {
+        std::vector<Decision> feedback;     // trigger = group, action = state
+        std::vector<float> gains;           // first group, on a constant input
+        std::array<bool, PluginProcessor::kNumGroups> muted {};
+    };
+
+    void setFadeTime(PluginProcessor& processor, int fadeTimeMs)
+    {
+        // Notified, as a host would, so the value reaches the audio thread
+        auto* fadeTime = processor.parameters.getParameter("fadeTime");
+        fadeTime->setValueNotifyingHost(fadeTime->convertTo0to1(static_cast<float>(fadeTimeMs)));
+    }
+
+    Trace runProcessor(const std::vector<Event>& events, const std::vector<int>& partition, bool lookahead, int fadeTimeMs)
+    {
+        PluginProcessor processor;
+
+        // Each group stops on an even note and goes on the next odd one
+        for (int group = 0; group < PluginProcessor::kNumGroups; ++group)
+        {
+            const int note = 36 + 2 * (group % 8);
+            processor.addTrigger(group, 0, (0x90 << 8) | note);
+            processor.addTrigger(group, 1, (0x90 << 8) | (note + 1));
+
+            for (int state = 0; state < MidiFeedback::kNumStates; ++state)
+                processor.setFeedbackMessage(group, static_cast<MidiFeedback::State>(state), 0,
+                                             juce::MidiMessage::controllerEvent(kFeedbackChannel, 100 + group, state));
+        }
+
+        processor.setLookahead(lookahead);
+        setFadeTime(processor, fadeTimeMs);
+
+        processor.setPlayConfigDetails(2, 2, kSampleRate, kMaxBlockSize);
+        processor.prepareToPlay(kSampleRate, kMaxBlockSize);
+
+        Trace trace;
+        juce::AudioBuffer<float> buffer(2, kMaxBlockSize);
+        juce::int64 start = 0;
+
+        for (const int size : partition)
+        {
+            juce::AudioBuffer<float> block(buffer.getArrayOfWritePointers(), 2, size);
+            for (int ch = 0; ch < 2; ++ch)
+                juce::FloatVectorOperations::fill(block.getWritePointer(ch), 1.0f, size);
+
+            auto midi = getBlock(events, start, size);
+            processor.processBlock(block, midi);
+
+            for (const auto metadata : midi)
+            {
+                const auto message = metadata.getMessage();
+                if (message.isController() && message.getChannel() == kFeedbackChannel)
+                    trace.feedback.push_back({ start + metadata.samplePosition, message.getControllerNumber() - 100,
+                                               message.getControllerValue(), true });
+            }
+
+            for (int s = 0; s < size; ++s)
+                trace.gains.push_back(block.getSample(0, s));
+            start += size;
+        }
+
+        for (int group = 0; group < PluginProcessor::kNumGroups; ++group)
+            trace.muted[static_cast<size_t>(group)] = processor.isMuted(group);
+
+        processor.releaseResources();
+        return trace;
+    }
+
+    bool testProcessor(juce::Random& random)
+    {
+        const auto length = static_cast<juce::int64>(kSampleRate * (1 + random.nextInt(4)));
+        const auto events = makeStream(random, length);
+        const bool lookahead = random.nextBool();
+        const int fadeTimeMs = 1 + random.nextInt(200);
+
+        const auto expected = runProcessor(events, makeFixedPartition(length), lookahead, fadeTimeMs);
+        const auto actual = runProcessor(events, makePartition(random, length), lookahead, fadeTimeMs);
+
+        if (actual.feedback != expected.feedback)
+        {
+            std::fprintf(stderr, "processor: %d feedback messages against %d\n", static_cast<int>(actual.feedback.size()),
+                         static_cast<int>(expected.feedback.size()));
+            return false;
+        }
+
+        if (actual.muted != expected.muted)
+        {
+            std::fprintf(stderr, "processor: final mute states differ\n");
+            return false;
+        }
+
+        // Ramps are generated per block, so allow for rounding
+        for (size_t i = 0; i < expected.gains.size(); ++i)
+        {
+            if (std::abs(actual.gains[i] - expected.gains[i]) > 1.0e-4f)
+            {
+                std::fprintf(stderr, "processor: gain %f against %f at sample %d\n", actual.gains[i], expected.gains[i],
+                             static_cast<int>(i));
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    //==============================================================================
+    bool testState(juce::Random& random)
+    {
+        const int fadeTimeMs = 1 + random.nextInt(1000);
+        const int group = random.nextInt(PluginProcessor::kNumGroups);
+
+        PluginProcessor original;
+        setFadeTime(original, fadeTimeMs);
+        original.addTrigger(group, random.nextInt(2), (0x90 << 8) | random.nextInt(128));
+
+        juce::MemoryBlock saved;
+        original.getStateInformation(saved);
+
+        PluginProcessor restored;
+        restored.setStateInformation(saved.getData(), static_cast<int>(saved.getSize()));
+
+        const auto restoredMs = juce::roundToInt(restored.parameters.getRawParameterValue("fadeTime")->load());
+        if (restoredMs != fadeTimeMs)
+        {
+            std::fprintf(stderr, "state: fade time %d restored as %d\n", fadeTimeMs, restoredMs);
+            return false;
+        }
+
+        juce::MemoryBlock resaved;
+        restored.getStateInformation(resaved);
+        if (resaved != saved)
+        {
+            std::fprintf(stderr, "state: saving a restored state changed it\n");
+            return false;
+        }
+
+        return true;
+    }
+}
+
+//==============================================================================
+int main(int argc, char* argv[])
+{
+    // The processor is a Timer, so a message manager has to exist
+    juce::ScopedJuceInitialiser_GUI juceInitialiser;
+
+    juce::ArgumentList args(argc, argv);
+    const int iterations = args.containsOption("--iterations") ? args.getValueForOption("--iterations").getIntValue() : 100;
+    const auto seed = args.containsOption("--seed") ? args.getValueForOption("--seed").getLargeIntValue()
+                                                    : juce::Time::currentTimeMillis();
+
+    int failures = 0;
+
+    for (int i = 0; i < iterations; ++i)
+    {
+        // Each iteration has its own seed, printed so a failure can be replayed
+        const auto iterationSeed = seed + i;
+        juce::Random random(iterationSeed);
+
+        const bool passed = testDebouncer(random) && testProcessor(random) && testState(random);
+        if (! passed)
+        {
+            std::fprintf(stderr, "failed with --seed=%lld --iterations=1\n", static_cast<long long>(iterationSeed));
+            ++failures;
+        }
+    }
+
+    std::printf("%d of %d iterations passed\n", iterations - failures, iterations);
+    return failures == 0 ? 0 : 1;
+}